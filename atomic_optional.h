@@ -0,0 +1,148 @@
+#ifndef ATOMIC_OPTIONAL_H
+#define ATOMIC_OPTIONAL_H
+#include "optional_ext.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+namespace knatten {
+    //An optional<T> that several threads can load, store and modify at once without a lock.
+    //The presence flag and the value are packed into a single 64 bit word, so every operation
+    //is one atomic operation on that word, or a compare-and-swap loop for transform.
+    //
+    //T must be trivially copyable and default constructible, and either have an enabled
+    //niche_traits<T> and be at most 8 bytes, in which case no value is stored as the niche, or
+    //be at most 7 bytes, leaving the last byte for the presence flag.
+    //Like std::atomic, compare_exchange compares object representations and not operator==,
+    //so it should not be used with a T that has padding bits.
+    template <class T>
+    class atomic_optional {
+        using word = std::uint64_t;
+
+        static_assert(std::is_trivially_copyable_v<T>, "atomic_optional requires a trivially copyable T");
+        static_assert(std::is_default_constructible_v<T>, "atomic_optional requires a default constructible T");
+        static_assert(niche_traits<T>::enabled ? sizeof(T) <= sizeof(word) : sizeof(T) < sizeof(word),
+            "atomic_optional<T> requires T to fit in 8 bytes with a niche, or 7 bytes without one");
+
+    public:
+        static constexpr bool is_always_lock_free = std::atomic<word>::is_always_lock_free;
+
+        atomic_optional() noexcept : w_(pack(optional<T>())) { }
+        atomic_optional(const optional<T>& o) noexcept : w_(pack(o)) { }
+
+        atomic_optional(const atomic_optional&) = delete;
+        atomic_optional& operator=(const atomic_optional&) = delete;
+
+        bool is_lock_free() const noexcept { return w_.is_lock_free(); }
+
+        optional<T> load(std::memory_order order = std::memory_order_seq_cst) const noexcept {
+            return unpack(w_.load(order));
+        }
+
+        void store(const optional<T>& o, std::memory_order order = std::memory_order_seq_cst) noexcept {
+            w_.store(pack(o), order);
+        }
+
+        optional<T> exchange(const optional<T>& o, std::memory_order order = std::memory_order_seq_cst) noexcept {
+            return unpack(w_.exchange(pack(o), order));
+        }
+
+        bool compare_exchange_weak(optional<T>& expected, const optional<T>& desired,
+                                   std::memory_order success, std::memory_order failure) noexcept {
+            word e = pack(expected);
+            bool exchanged = w_.compare_exchange_weak(e, pack(desired), success, failure);
+            expected = unpack(e);
+            return exchanged;
+        }
+
+        bool compare_exchange_weak(optional<T>& expected, const optional<T>& desired,
+                                   std::memory_order order = std::memory_order_seq_cst) noexcept {
+            return compare_exchange_weak(expected, desired, order, failure_order(order));
+        }
+
+        bool compare_exchange_strong(optional<T>& expected, const optional<T>& desired,
+                                     std::memory_order success, std::memory_order failure) noexcept {
+            word e = pack(expected);
+            bool exchanged = w_.compare_exchange_strong(e, pack(desired), success, failure);
+            expected = unpack(e);
+            return exchanged;
+        }
+
+        bool compare_exchange_strong(optional<T>& expected, const optional<T>& desired,
+                                     std::memory_order order = std::memory_order_seq_cst) noexcept {
+            return compare_exchange_strong(expected, desired, order, failure_order(order));
+        }
+
+        //If there is a value v, atomically replace it with op(v) and return the new value,
+        //otherwise return an empty optional. op is called again if another thread changed
+        //the value in the meantime, so it should not have side effects.
+        template <class UnaryOperation>
+        optional<T> transform(UnaryOperation&& op, std::memory_order order = std::memory_order_seq_cst) {
+            word current = w_.load(failure_order(order));
+            for (;;) {
+                optional<T> o = unpack(current);
+                if (!o.has_value()) {
+                    return o;
+                }
+                optional<T> desired(std::in_place, detail::invoke(op, *o));
+                if (w_.compare_exchange_weak(current, pack(desired), order, failure_order(order))) {
+                    return desired;
+                }
+            }
+        }
+
+    private:
+        //The layout of the word for a T without a niche
+        struct flagged {
+            unsigned char value[sizeof(word) - 1];
+            unsigned char present;
+        };
+
+        static word pack(const optional<T>& o) noexcept {
+            word w = 0;
+            if constexpr (niche_traits<T>::enabled) {
+                const T v = o.has_value() ? *o : niche_traits<T>::empty_value();
+                std::memcpy(&w, &v, sizeof(T));
+            } else {
+                flagged f{};
+                if (o.has_value()) {
+                    std::memcpy(f.value, &*o, sizeof(T));
+                    f.present = 1;
+                }
+                std::memcpy(&w, &f, sizeof(w));
+            }
+            return w;
+        }
+
+        static optional<T> unpack(word w) noexcept {
+            T v;
+            if constexpr (niche_traits<T>::enabled) {
+                std::memcpy(&v, &w, sizeof(T));
+                if (niche_traits<T>::is_empty(v)) {
+                    return optional<T>();
+                }
+            } else {
+                flagged f;
+                std::memcpy(&f, &w, sizeof(w));
+                if (!f.present) {
+                    return optional<T>();
+                }
+                std::memcpy(&v, f.value, sizeof(T));
+            }
+            return optional<T>(std::in_place, v);
+        }
+
+        static constexpr std::memory_order failure_order(std::memory_order order) noexcept {
+            switch (order) {
+                case std::memory_order_acq_rel: return std::memory_order_acquire;
+                case std::memory_order_release: return std::memory_order_relaxed;
+                default: return order;
+            }
+        }
+
+        std::atomic<word> w_;
+    };
+}
+#endif
@@ -0,0 +1,110 @@
+#include "atomic_optional.h"
+#include "catch.hpp"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using knatten::optional;
+using knatten::atomic_optional;
+
+namespace {
+    struct job { int id; };
+    enum class slot : std::uint64_t { };
+    struct small { std::int16_t a; std::int16_t b; };
+}
+
+template <> struct knatten::niche_traits<job*> : knatten::null_pointer_niche<job*> { };
+template <> struct knatten::niche_traits<slot> : knatten::sentinel_niche<slot, slot(~std::uint64_t(0))> { };
+
+TEST_CASE("atomic_optional load and store") {
+    SECTION("without a niche") {
+        atomic_optional<int> a;
+        REQUIRE(a.load().has_value() == false);
+        a.store(optional(3));
+        REQUIRE(a.load().value() == 3);
+        a.store(optional<int>());
+        REQUIRE(a.load().has_value() == false);
+
+        atomic_optional<small> s(optional(small{1, 2}));
+        REQUIRE(s.load()->b == 2);
+    }
+
+    SECTION("with a niche") {
+        job j{1};
+        atomic_optional<job*> a{optional(&j)};
+        REQUIRE(a.load().value()->id == 1);
+        a.store(optional<job*>());
+        REQUIRE(a.load().has_value() == false);
+
+        atomic_optional<slot> s(optional(slot(5)));
+        REQUIRE(s.load().value() == slot(5));
+    }
+
+    SECTION("is lock free") {
+        static_assert(atomic_optional<int>::is_always_lock_free);
+        static_assert(atomic_optional<slot>::is_always_lock_free);
+        REQUIRE(atomic_optional<job*>().is_lock_free());
+    }
+}
+
+TEST_CASE("atomic_optional exchange and compare_exchange") {
+    SECTION("exchange") {
+        atomic_optional<int> a(optional(1));
+        REQUIRE(a.exchange(optional(2)).value() == 1);
+        REQUIRE(a.exchange(optional<int>()).value() == 2);
+        REQUIRE(a.exchange(optional(3)).has_value() == false);
+    }
+
+    SECTION("compare_exchange_strong") {
+        atomic_optional<int> a;
+        optional<int> expected(1);
+        REQUIRE(a.compare_exchange_strong(expected, optional(2)) == false);
+        REQUIRE(expected.has_value() == false);
+        REQUIRE(a.compare_exchange_strong(expected, optional(2)) == true);
+        REQUIRE(a.load().value() == 2);
+    }
+
+    SECTION("compare_exchange_weak") {
+        atomic_optional<slot> a(optional(slot(1)));
+        optional<slot> expected(slot(1));
+        while (!a.compare_exchange_weak(expected, optional<slot>(), std::memory_order_acq_rel)) {
+            REQUIRE(expected.value() == slot(1));
+        }
+        REQUIRE(a.load().has_value() == false);
+    }
+}
+
+TEST_CASE("atomic_optional transform") {
+    SECTION("with value") {
+        atomic_optional<int> a(optional(2));
+        REQUIRE(a.transform([](int v){ return v*3;}).value() == 6);
+        REQUIRE(a.load().value() == 6);
+    }
+
+    SECTION("with no value") {
+        atomic_optional<int> a;
+        bool called = false;
+        REQUIRE(a.transform([&called](int v){ called = true; return v;}).has_value() == false);
+        REQUIRE(called == false);
+        REQUIRE(a.load().has_value() == false);
+    }
+
+    SECTION("from several threads") {
+        constexpr int threads = 4;
+        constexpr int increments = 10000;
+        atomic_optional<int> a(optional(0));
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&a]{
+                for (int i = 0; i < increments; ++i) {
+                    a.transform([](int v){ return v+1;}, std::memory_order_relaxed);
+                }
+            });
+        }
+        for (auto& w : workers) {
+            w.join();
+        }
+        REQUIRE(a.load().value() == threads * increments);
+    }
+}
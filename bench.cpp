@@ -0,0 +1,429 @@
+//Micro-benchmarks of transform, transform_optional and call, against the equivalent
+//hand-written has_value() branches on knatten::optional and on std::optional.
+//Build in release mode and run ./bench, numbers are nanoseconds per element.
+#include "bench.h"
+#include "optional_ext.h"
+#include "atomic_optional.h"
+#include "once_optional.h"
+#include "optional_memo.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using std::size_t;
+using std::string;
+using knatten::optional;
+using bench::do_not_optimize;
+using bench::measure;
+
+namespace {
+    struct large {
+        std::array<char, 4096> data;
+    };
+
+    //The payload types, each with a way to make one and a cheap projection to call on it
+    struct int_case {
+        using type = int;
+        static constexpr const char* name = "int";
+        static constexpr size_t count = 1 << 16;
+        static int make(size_t i) { return static_cast<int>(i); }
+        static size_t project(const int& v) { return static_cast<size_t>(v) * 2 + 1; }
+    };
+
+    struct string_case {
+        using type = string;
+        static constexpr const char* name = "string";
+        static constexpr size_t count = 1 << 14;
+        static string make(size_t i) { return string(16 + i % 32, 'x'); }
+        static size_t project(const string& v) { return v.size(); }
+    };
+
+    struct large_case {
+        using type = large;
+        static constexpr const char* name = "large";
+        static constexpr size_t count = 1 << 10;
+        static large make(size_t i) { large l; l.data.fill(static_cast<char>(i)); return l; }
+        static size_t project(const large& v) { return static_cast<size_t>(v.data[0] + v.data[4095]); }
+    };
+
+    enum class qualifier { lvalue, const_lvalue, rvalue };
+
+    const char* name(qualifier q) {
+        switch (q) {
+            case qualifier::lvalue: return "&";
+            case qualifier::const_lvalue: return "const&";
+            case qualifier::rvalue: return "&&";
+        }
+        return "";
+    }
+
+    //Calls o, std::as_const(o) or std::move(o) depending on Q
+    template <qualifier Q, class O>
+    decltype(auto) qualified(O& o) {
+        if constexpr (Q == qualifier::lvalue) {
+            return static_cast<O&>(o);
+        } else if constexpr (Q == qualifier::const_lvalue) {
+            return static_cast<const O&>(o);
+        } else {
+            return static_cast<O&&>(o);
+        }
+    }
+
+    template <class Case, qualifier Q>
+    struct benchmarks {
+        using T = typename Case::type;
+
+        static double transform(const std::vector<optional<T>>& input) {
+            return measure(input, [](std::vector<optional<T>>& in) {
+                for (auto& o : in) {
+                    auto r = qualified<Q>(o).transform([](auto&& v) { return Case::project(v); });
+                    do_not_optimize(r);
+                }
+            });
+        }
+
+        static double transform_branch(const std::vector<optional<T>>& input) {
+            return measure(input, [](std::vector<optional<T>>& in) {
+                for (auto& o : in) {
+                    auto r = o.has_value() ? optional<size_t>(Case::project(*qualified<Q>(o))) : optional<size_t>();
+                    do_not_optimize(r);
+                }
+            });
+        }
+
+        static double transform_std(const std::vector<std::optional<T>>& input) {
+            return measure(input, [](std::vector<std::optional<T>>& in) {
+                for (auto& o : in) {
+                    auto r = o.has_value() ? std::optional<size_t>(Case::project(*qualified<Q>(o))) : std::optional<size_t>();
+                    do_not_optimize(r);
+                }
+            });
+        }
+
+        static double transform_optional(const std::vector<optional<T>>& input) {
+            return measure(input, [](std::vector<optional<T>>& in) {
+                for (auto& o : in) {
+                    auto r = qualified<Q>(o).transform_optional([](auto&& v) { return optional<size_t>(Case::project(v)); });
+                    do_not_optimize(r);
+                }
+            });
+        }
+
+        static double transform_optional_branch(const std::vector<optional<T>>& input) {
+            return measure(input, [](std::vector<optional<T>>& in) {
+                auto op = [](auto&& v) { return optional<size_t>(Case::project(v)); };
+                for (auto& o : in) {
+                    auto r = o.has_value() ? op(*qualified<Q>(o)) : optional<size_t>();
+                    do_not_optimize(r);
+                }
+            });
+        }
+
+        static double transform_optional_std(const std::vector<std::optional<T>>& input) {
+            return measure(input, [](std::vector<std::optional<T>>& in) {
+                auto op = [](auto&& v) { return std::optional<size_t>(Case::project(v)); };
+                for (auto& o : in) {
+                    auto r = o.has_value() ? op(*qualified<Q>(o)) : std::optional<size_t>();
+                    do_not_optimize(r);
+                }
+            });
+        }
+
+        static double call(const std::vector<optional<T>>& input) {
+            return measure(input, [](std::vector<optional<T>>& in) {
+                size_t sum = 0;
+                for (auto& o : in) {
+                    qualified<Q>(o).call([&sum](auto&& v) { sum += Case::project(v); });
+                }
+                do_not_optimize(sum);
+            });
+        }
+
+        static double call_branch(const std::vector<optional<T>>& input) {
+            return measure(input, [](std::vector<optional<T>>& in) {
+                size_t sum = 0;
+                for (auto& o : in) {
+                    if (o.has_value()) {
+                        sum += Case::project(*qualified<Q>(o));
+                    }
+                }
+                do_not_optimize(sum);
+            });
+        }
+
+        static double call_std(const std::vector<std::optional<T>>& input) {
+            return measure(input, [](std::vector<std::optional<T>>& in) {
+                size_t sum = 0;
+                for (auto& o : in) {
+                    if (o.has_value()) {
+                        sum += Case::project(*qualified<Q>(o));
+                    }
+                }
+                do_not_optimize(sum);
+            });
+        }
+
+        static void run(int empty_percent, const std::vector<optional<T>>& ext, const std::vector<std::optional<T>>& std_input) {
+            auto row = [&](const char* function, double ext_ns, double branch_ns, double std_ns) {
+                std::printf("%-7s %-19s %-7s %6d%% %12.2f %12.2f %12.2f\n",
+                    Case::name, function, name(Q), empty_percent, ext_ns, branch_ns, std_ns);
+            };
+            row("transform", transform(ext), transform_branch(ext), transform_std(std_input));
+            row("transform_optional", transform_optional(ext), transform_optional_branch(ext), transform_optional_std(std_input));
+            row("call", call(ext), call_branch(ext), call_std(std_input));
+        }
+    };
+
+    template <class Case>
+    void run_case() {
+        using T = typename Case::type;
+        for (int empty_percent = 0; empty_percent <= 100; empty_percent += 25) {
+            std::mt19937 rng(42);
+            std::uniform_int_distribution<int> percent(0, 99);
+            std::vector<optional<T>> ext;
+            std::vector<std::optional<T>> std_input;
+            for (size_t i = 0; i < Case::count; ++i) {
+                if (percent(rng) < empty_percent) {
+                    ext.emplace_back();
+                    std_input.emplace_back();
+                } else {
+                    ext.emplace_back(Case::make(i));
+                    std_input.emplace_back(Case::make(i));
+                }
+            }
+            benchmarks<Case, qualifier::lvalue>::run(empty_percent, ext, std_input);
+            benchmarks<Case, qualifier::const_lvalue>::run(empty_percent, ext, std_input);
+            benchmarks<Case, qualifier::rvalue>::run(empty_percent, ext, std_input);
+        }
+    }
+}
+
+namespace {
+    //A functor carrying state, like a lambda capturing a small vector
+    struct stateful_op {
+        std::vector<int> weights = std::vector<int>(16, 1);
+        int operator()(int v) const { return v + weights[static_cast<size_t>(v) & 15]; }
+    };
+
+    //A chain of three transforms with the functor passed as is, which forwards it,
+    //against passing a copy every time, which is what taking it by value costs
+    void run_functor() {
+        std::vector<optional<int>> input;
+        for (size_t i = 0; i < int_case::count; ++i) {
+            input.emplace_back(static_cast<int>(i));
+        }
+        const stateful_op op;
+        double forwarded = measure(input, [&op](std::vector<optional<int>>& in) {
+            for (auto& o : in) {
+                auto r = o.transform(op).transform(op).transform(op);
+                do_not_optimize(r);
+            }
+        });
+        double copied = measure(input, [&op](std::vector<optional<int>>& in) {
+            for (auto& o : in) {
+                auto r = o.transform(stateful_op(op)).transform(stateful_op(op)).transform(stateful_op(op));
+                do_not_optimize(r);
+            }
+        });
+        std::printf("\n%-27s %12s %12s\n", "capturing functor", "forwarded", "copied");
+        std::printf("%-27s %12.2f %12.2f\n", "transform x3", forwarded, copied);
+    }
+}
+
+namespace {
+    struct nothrow_move_string {
+        string s;
+        explicit nothrow_move_string(size_t i) : s(string_case::make(i)) { }
+    };
+
+    //The same, but with a move constructor the compiler can not assume will not throw
+    struct throwing_move_string {
+        string s;
+        explicit throwing_move_string(size_t i) : s(string_case::make(i)) { }
+        throwing_move_string(const throwing_move_string&) = default;
+        throwing_move_string(throwing_move_string&& rhs) noexcept(false) : s(std::move(rhs.s)) { }
+    };
+
+    //Growing a vector<optional<T>> moves the elements if optional<T>'s move constructor is
+    //noexcept, and copies them otherwise. It is unconditionally noexcept by default, and follows
+    //T with KNATTEN_OPTIONAL_CONDITIONAL_NOEXCEPT, so compare the throwing column of ./bench with
+    //that of ./bench_noexcept, which is built with it.
+    template <class T>
+    double grow() {
+        std::vector<size_t> input(string_case::count);
+        return measure(input, [](std::vector<size_t>& in) {
+            std::vector<optional<T>> v;
+            for (size_t i : in) {
+                v.emplace_back(std::in_place, i);
+            }
+            do_not_optimize(v);
+        });
+    }
+
+    void run_growth() {
+#ifdef KNATTEN_OPTIONAL_CONDITIONAL_NOEXCEPT
+        std::printf("\nWith KNATTEN_OPTIONAL_CONDITIONAL_NOEXCEPT");
+#else
+        std::printf("\nWithout KNATTEN_OPTIONAL_CONDITIONAL_NOEXCEPT");
+#endif
+        std::printf("\n%-27s %12s %12s\n", "vector<optional<T>> growth", "noexcept", "throwing");
+        std::printf("%-27s %12.2f %12.2f\n", "emplace_back", grow<nothrow_move_string>(), grow<throwing_move_string>());
+    }
+}
+
+namespace {
+    //Readers of a "latest value if any" while another thread keeps publishing new values,
+    //through an optional guarded by a mutex against an atomic_optional
+    template <class Publish, class Read>
+    double contended(Publish publish, Read read) {
+        std::atomic<bool> done{false};
+        std::thread writer([&]{
+            for (int i = 0; !done.load(std::memory_order_relaxed); ++i) {
+                publish(i);
+            }
+        });
+        std::vector<int> input(int_case::count);
+        double ns = measure(input, [&read](std::vector<int>& in) {
+            for (auto& v : in) {
+                v = read();
+            }
+        });
+        done = true;
+        writer.join();
+        return ns;
+    }
+
+    void run_atomic() {
+        std::mutex m;
+        optional<int> guarded;
+        double locked = contended(
+            [&](int i) { std::lock_guard<std::mutex> lock(m); guarded = optional<int>(i); },
+            [&] { std::lock_guard<std::mutex> lock(m); return guarded.has_value() ? *guarded : -1; });
+
+        knatten::atomic_optional<int> latest;
+        double lock_free = contended(
+            [&](int i) { latest.store(optional<int>(i), std::memory_order_release); },
+            [&] { auto o = latest.load(std::memory_order_acquire); return o.has_value() ? *o : -1; });
+
+        std::printf("\n%-27s %12s %12s\n", "latest value, one writer", "mutex", "atomic");
+        std::printf("%-27s %12.2f %12.2f\n", "load", locked, lock_free);
+    }
+}
+
+namespace {
+    //Reading an already computed value, through once_optional against std::call_once plus a
+    //plain optional, which is what once_optional replaces
+    void run_once() {
+        std::vector<int> input(int_case::count);
+        knatten::once_optional<int> cached;
+        double once = measure(input, [&cached](std::vector<int>& in) {
+            for (auto& v : in) {
+                v = *cached.get_or_init([]{ return 42; });
+            }
+        });
+
+        std::once_flag flag;
+        optional<int> value;
+        double call_once = measure(input, [&flag, &value](std::vector<int>& in) {
+            for (auto& v : in) {
+                std::call_once(flag, [&value]{ value = optional<int>(42); });
+                v = *value;
+            }
+        });
+
+        std::printf("\n%-27s %12s %12s\n", "lazily initialised value", "once", "call_once");
+        std::printf("%-27s %12.2f %12.2f\n", "get_or_init", once, call_once);
+    }
+}
+
+namespace {
+    //Something worth caching, a few hundred dependent multiplications
+    size_t expensive(const int& v) {
+        size_t h = static_cast<size_t>(v);
+        for (int i = 0; i < 256; ++i) {
+            h = h * 0x9e3779b97f4a7c15ull + 1;
+        }
+        return h;
+    }
+
+    //transform with a function called on a few thousand distinct values over and over,
+    //directly and through memoized with room for all of them
+    void run_memo() {
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<int> distinct(0, 2999);
+        std::vector<optional<int>> input;
+        for (size_t i = 0; i < int_case::count; ++i) {
+            input.emplace_back(distinct(rng));
+        }
+        double direct = measure(input, [](std::vector<optional<int>>& in) {
+            for (auto& o : in) {
+                do_not_optimize(o.transform(expensive));
+            }
+        });
+        auto cached = knatten::memoized<int>(expensive, 4096);
+        double memo = measure(input, [&cached](std::vector<optional<int>>& in) {
+            for (auto& o : in) {
+                do_not_optimize(o.transform(cached));
+            }
+        });
+        std::printf("\n%-27s %12s %12s\n", "3000 distinct values", "direct", "memoized");
+        std::printf("%-27s %12.2f %12.2f\n", "transform", direct, memo);
+    }
+}
+
+namespace {
+    //Replacing the value of each optional<string> with a modified string, by assigning the result
+    //of transform back against transform_in_place
+    void run_in_place() {
+        std::vector<optional<string>> input;
+        for (size_t i = 0; i < string_case::count; ++i) {
+            input.emplace_back(string_case::make(i));
+        }
+        double copied = measure(input, [](std::vector<optional<string>>& in) {
+            for (auto& o : in) {
+                o = o.transform([](const string& s){ string r = s; r[0] = 'y'; return r;});
+            }
+        });
+        double modified = measure(input, [](std::vector<optional<string>>& in) {
+            for (auto& o : in) {
+                o.transform_in_place([](string& s){ s[0] = 'y';});
+            }
+        });
+        double moved = measure(input, [](std::vector<optional<string>>& in) {
+            for (auto& o : in) {
+                o = std::move(o).transform([](string&& s){ s[0] = 'y'; return std::move(s);});
+            }
+        });
+        double moved_in_place = measure(input, [](std::vector<optional<string>>& in) {
+            for (auto& o : in) {
+                o.transform_in_place([](string&& s){ s[0] = 'y'; return std::move(s);});
+            }
+        });
+        std::printf("\n%-27s %12s %12s\n", "string -> string", "transform", "in_place");
+        std::printf("%-27s %12.2f %12.2f\n", "lvalue, modify", copied, modified);
+        std::printf("%-27s %12.2f %12.2f\n", "rvalue, move", moved, moved_in_place);
+    }
+}
+
+int main() {
+    std::printf("%-7s %-19s %-7s %7s %12s %12s %12s\n",
+        "type", "function", "this", "empty", "optional_ext", "branch", "std");
+    run_case<int_case>();
+    run_case<string_case>();
+    run_case<large_case>();
+    run_functor();
+    run_growth();
+    run_atomic();
+    run_once();
+    run_memo();
+    run_in_place();
+}
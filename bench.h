@@ -0,0 +1,27 @@
+#ifndef BENCH_H
+#define BENCH_H
+//The timing harness shared by the benchmark executables
+#include <chrono>
+
+namespace bench {
+    template <class T>
+    void do_not_optimize(const T& value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    //Runs body over fresh copies of input reps times, timing only body, in ns per element
+    template <class Container, class Body>
+    double measure(const Container& input, Body body) {
+        constexpr int reps = 20;
+        std::chrono::nanoseconds total{0};
+        for (int rep = 0; rep < reps; ++rep) {
+            Container work = input;
+            auto start = std::chrono::steady_clock::now();
+            body(work);
+            total += std::chrono::steady_clock::now() - start;
+            do_not_optimize(work);
+        }
+        return static_cast<double>(total.count()) / (reps * static_cast<double>(input.size()));
+    }
+}
+#endif
@@ -0,0 +1,88 @@
+//Benchmarks of optional_coroutine.h: three lookups that may each come up empty, written as
+//hand-written has_value() branches, as a transform_optional chain and as a coroutine.
+//Also counts heap allocations per call, to show that coroutine frames do not hit the heap.
+//Build in release mode and run ./bench_coroutine, numbers are nanoseconds per element.
+#include "bench.h"
+#include "optional_coroutine.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+using std::size_t;
+using knatten::optional;
+using bench::do_not_optimize;
+using bench::measure;
+
+namespace {
+    size_t allocations = 0;
+}
+
+void* operator new(size_t size) {
+    ++allocations;
+    if (void* p = std::malloc(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+    //Empty for one in seven values
+    optional<int> lookup(int v) {
+        return v % 7 == 0 ? optional<int>() : optional(v + 1);
+    }
+
+    optional<int> branch(int v) {
+        auto a = lookup(v);
+        if (!a.has_value()) {
+            return optional<int>();
+        }
+        auto b = lookup(*a);
+        if (!b.has_value()) {
+            return optional<int>();
+        }
+        return lookup(*b);
+    }
+
+    optional<int> chain(int v) {
+        return lookup(v).transform_optional(lookup).transform_optional(lookup);
+    }
+
+    optional<int> coroutine(int v) {
+        int a = co_await lookup(v);
+        int b = co_await lookup(a);
+        co_return co_await lookup(b);
+    }
+
+    template <class F>
+    void row(const char* name, F f) {
+        std::vector<int> input(1 << 16);
+        for (size_t i = 0; i < input.size(); ++i) {
+            input[i] = static_cast<int>(i);
+        }
+        auto run = [f](std::vector<int>& in) {
+            for (auto& v : in) {
+                auto r = f(v);
+                do_not_optimize(r);
+            }
+        };
+        double ns = measure(input, run);
+        size_t before = allocations;
+        std::vector<int> work = input;
+        run(work);
+        double per_call = static_cast<double>(allocations - before - 1) / static_cast<double>(input.size());
+        std::printf("%-12s %12.2f %16.4f\n", name, ns, per_call);
+    }
+}
+
+int main() {
+    std::printf("%-12s %12s %16s\n", "function", "ns", "allocations/call");
+    row("branch", branch);
+    row("chain", chain);
+    row("coroutine", coroutine);
+}
@@ -0,0 +1,127 @@
+//Benchmarks of optional_ranges.h: summing what is left of a range of optionals after a filter
+//and a transform, eagerly through intermediate vectors, as a hand-written loop and as a views
+//pipeline. Build in release mode and run ./bench_ranges, numbers are nanoseconds per element.
+#include "bench.h"
+#include "optional_ranges.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <ranges>
+#include <vector>
+
+using std::size_t;
+using knatten::optional;
+namespace views = knatten::views;
+using bench::do_not_optimize;
+using bench::measure;
+
+namespace {
+    long scale(int v) { return static_cast<long>(v) * 3; }
+
+    //Empty for one in seven values
+    optional<long> lookup(int v) {
+        return v % 7 == 0 ? optional<long>() : optional(static_cast<long>(v) + 1);
+    }
+
+    //present, then a transform of each value
+    double present_eager(const std::vector<optional<int>>& input) {
+        return measure(input, [](std::vector<optional<int>>& in) {
+            std::vector<int> values;
+            for (const auto& o : in) {
+                if (o.has_value()) {
+                    values.push_back(*o);
+                }
+            }
+            std::vector<long> scaled;
+            for (int v : values) {
+                scaled.push_back(scale(v));
+            }
+            long sum = 0;
+            for (long v : scaled) {
+                sum += v;
+            }
+            do_not_optimize(sum);
+        });
+    }
+
+    double present_loop(const std::vector<optional<int>>& input) {
+        return measure(input, [](std::vector<optional<int>>& in) {
+            long sum = 0;
+            for (const auto& o : in) {
+                if (o.has_value()) {
+                    sum += scale(*o);
+                }
+            }
+            do_not_optimize(sum);
+        });
+    }
+
+    double present_views(const std::vector<optional<int>>& input) {
+        return measure(input, [](std::vector<optional<int>>& in) {
+            long sum = 0;
+            for (long v : in | views::present | std::views::transform(scale)) {
+                sum += v;
+            }
+            do_not_optimize(sum);
+        });
+    }
+
+    //and_then, then present
+    double and_then_eager(const std::vector<optional<int>>& input) {
+        return measure(input, [](std::vector<optional<int>>& in) {
+            std::vector<optional<long>> found;
+            for (const auto& o : in) {
+                found.push_back(o.transform_optional(lookup));
+            }
+            std::vector<long> values;
+            for (const auto& o : found) {
+                if (o.has_value()) {
+                    values.push_back(*o);
+                }
+            }
+            long sum = 0;
+            for (long v : values) {
+                sum += v;
+            }
+            do_not_optimize(sum);
+        });
+    }
+
+    double and_then_loop(const std::vector<optional<int>>& input) {
+        return measure(input, [](std::vector<optional<int>>& in) {
+            long sum = 0;
+            for (const auto& o : in) {
+                if (o.has_value()) {
+                    auto found = lookup(*o);
+                    if (found.has_value()) {
+                        sum += *found;
+                    }
+                }
+            }
+            do_not_optimize(sum);
+        });
+    }
+
+    double and_then_views(const std::vector<optional<int>>& input) {
+        return measure(input, [](std::vector<optional<int>>& in) {
+            long sum = 0;
+            for (long v : in | views::and_then(lookup) | views::present) {
+                sum += v;
+            }
+            do_not_optimize(sum);
+        });
+    }
+}
+
+int main() {
+    //Empty for one in three values
+    std::vector<optional<int>> input;
+    for (size_t i = 0; i < (1 << 16); ++i) {
+        input.push_back(i % 3 == 0 ? optional<int>() : optional(static_cast<int>(i)));
+    }
+    std::printf("%-22s %12s %12s %12s\n", "pipeline", "eager", "loop", "views");
+    std::printf("%-22s %12.2f %12.2f %12.2f\n", "present | transform",
+        present_eager(input), present_loop(input), present_views(input));
+    std::printf("%-22s %12.2f %12.2f %12.2f\n", "and_then | present",
+        and_then_eager(input), and_then_loop(input), and_then_views(input));
+}
@@ -0,0 +1,82 @@
+# Checks the assembly generated for snippets.cpp. Run as
+#     cmake -DASM=<file.s> -DBASELINE=<file.txt> [-DUPDATE=ON] -P check.cmake
+#
+# For every function in the assembly it counts the instructions and collects the calls, then
+#  - fails if it calls anything but the user functions declared in snippets.cpp and memmove,
+#    meaning some part of optional_ext.h was not inlined,
+#  - fails if it has more instructions than recorded in BASELINE,
+#  - reports how a *_new function compares with its hand-written *_old twin.
+# With UPDATE=ON the baseline is rewritten instead. Without a baseline for this compiler
+# and optimisation level, only the calls are checked.
+
+set(allowed_calls "^(_Z[0-9]+(find_first|lookup_author|tweet_replied_to|notify)|memmove)")
+
+file(STRINGS "${ASM}" lines)
+set(function "")
+set(functions "")
+set(failed FALSE)
+foreach(line IN LISTS lines)
+    if(line MATCHES "^([a-z_]+_(old|new)):$")
+        set(function "${CMAKE_MATCH_1}")
+        list(APPEND functions "${function}")
+        set(count_${function} 0)
+    elseif(function AND line MATCHES "^\t\\.cfi_endproc")
+        set(function "")
+    elseif(function AND line MATCHES "^\t[a-z]")
+        math(EXPR count_${function} "${count_${function}} + 1")
+        if(line MATCHES "^\t(call|jmp)[a-z]*\t([^ .][^ ]*)$")
+            string(REGEX REPLACE "@PLT$" "" callee "${CMAKE_MATCH_2}")
+            if(NOT callee MATCHES "${allowed_calls}")
+                message(SEND_ERROR "${function} calls ${callee}, which should have been inlined")
+                set(failed TRUE)
+            endif()
+        endif()
+    endif()
+endforeach()
+
+if(NOT functions)
+    message(FATAL_ERROR "No snippet functions found in ${ASM}")
+endif()
+
+if(UPDATE)
+    set(baseline "")
+    foreach(f IN LISTS functions)
+        string(APPEND baseline "${f} ${count_${f}}\n")
+    endforeach()
+    file(WRITE "${BASELINE}" "${baseline}")
+    message(STATUS "Wrote ${BASELINE}")
+    return()
+endif()
+
+if(EXISTS "${BASELINE}")
+    file(STRINGS "${BASELINE}" baseline_lines)
+    foreach(entry IN LISTS baseline_lines)
+        if(entry MATCHES "^([a-z_]+) ([0-9]+)$")
+            set(f "${CMAKE_MATCH_1}")
+            set(expected "${CMAKE_MATCH_2}")
+            if(NOT DEFINED count_${f})
+                message(SEND_ERROR "${f} is in ${BASELINE} but not in ${ASM}")
+                set(failed TRUE)
+            elseif(count_${f} GREATER expected)
+                message(SEND_ERROR "${f} grew from ${expected} to ${count_${f}} instructions")
+                set(failed TRUE)
+            elseif(count_${f} LESS expected)
+                message(STATUS "${f} shrank from ${expected} to ${count_${f}} instructions, consider updating the baseline")
+            endif()
+        endif()
+    endforeach()
+else()
+    message(STATUS "No baseline ${BASELINE}, only checking calls")
+endif()
+
+foreach(f IN LISTS functions)
+    if(f MATCHES "^(.*)_new$")
+        set(old "${CMAKE_MATCH_1}_old")
+        math(EXPR overhead "${count_${f}} - ${count_${old}}")
+        message(STATUS "${CMAKE_MATCH_1}: ${count_${old}} instructions hand-written, ${count_${f}} with optional_ext (${overhead})")
+    endif()
+endforeach()
+
+if(failed)
+    message(FATAL_ERROR "Codegen check of ${ASM} failed")
+endif()
@@ -0,0 +1,82 @@
+//Representative uses of optional_ext.h, each paired with the hand-written branch it replaces.
+//check.cmake compiles this to assembly and requires every function to call nothing but the
+//user functions declared below and memmove, and to be no bigger than its instruction count in
+//the stored baseline. How each *_new function compares with its *_old twin is only reported.
+#include "optional_ext.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+using knatten::optional;
+
+struct tweet {
+    int id;
+};
+
+struct author {
+    int id;
+};
+
+//Deliberately only declared, so the calls to them survive and everything else must be inlined
+optional<tweet> find_first(int key);
+author lookup_author(const tweet& t);
+optional<tweet> tweet_replied_to(const tweet& t);
+void notify(const tweet& t);
+
+extern "C" int transform_old(int key) {
+    auto foo = find_first(key);
+    auto foo_author(foo.has_value() ? optional<author>(lookup_author(*foo)) : optional<author>());
+    return foo_author.has_value() ? foo_author->id : -1;
+}
+
+extern "C" int transform_new(int key) {
+    auto foo_author = find_first(key).transform(lookup_author);
+    return foo_author.has_value() ? foo_author->id : -1;
+}
+
+extern "C" int transform_optional_old(int key) {
+    auto foo = find_first(key);
+    auto foo_replied_to(foo.has_value() ? tweet_replied_to(*foo) : optional<tweet>());
+    return foo_replied_to.has_value() ? foo_replied_to->id : -1;
+}
+
+extern "C" int transform_optional_new(int key) {
+    auto foo_replied_to = find_first(key).transform_optional(tweet_replied_to);
+    return foo_replied_to.has_value() ? foo_replied_to->id : -1;
+}
+
+extern "C" void call_old(int key) {
+    auto foo = find_first(key);
+    if (foo.has_value()) {
+        notify(*foo);
+    }
+}
+
+extern "C" void call_new(int key) {
+    find_first(key).call(notify);
+}
+
+extern "C" int combined_old(int key) {
+    auto foo = find_first(key);
+    auto foo_replied_to(foo.has_value() ? tweet_replied_to(*foo) : optional<tweet>());
+    auto orig_author(foo_replied_to.has_value() ? optional<author>(lookup_author(*foo_replied_to)) : optional<author>());
+    return orig_author.has_value() ? orig_author->id : -1;
+}
+
+extern "C" int combined_new(int key) {
+    auto orig_author = find_first(key)
+        .transform_optional(tweet_replied_to)
+        .transform(lookup_author);
+    return orig_author.has_value() ? orig_author->id : -1;
+}
+
+//optional<int> is trivially copyable, so std::copy over an array of them must become a
+//single memmove rather than a loop
+extern "C" void copy_old(const optional<int>* first, std::size_t n, optional<int>* out) {
+    std::memmove(out, first, n * sizeof(optional<int>));
+}
+
+extern "C" void copy_new(const optional<int>* first, std::size_t n, optional<int>* out) {
+    std::copy(first, first + n, out);
+}
@@ -0,0 +1,25 @@
+//Compile-time benchmark for optional_ext.h: 64 groups of distinct lambdas, each run through
+//transform, transform_optional and call on every value category, the way a large code base
+//instantiates the overload sets. Build the compile_bench target and compare the time it takes
+//with COMPILE_BENCH_STANDARD=17 (ref-qualified overloads) and 23 (explicit object parameters).
+#include "optional_ext.h"
+
+using knatten::optional;
+
+#define OPTIONAL_EXT_CHAIN(n) \
+    sum += *optional(n).transform([](int&& v){ return v + n; }); \
+    sum += *o.transform([](int& v){ return v * n; }); \
+    sum += *co.transform_optional([](const int& v){ return optional(v - n); }); \
+    sum += *std::move(o).transform_optional([](int&& v){ return optional(v ^ n); }); \
+    co.call([&sum](const int& v){ sum += v + n; }); \
+    std::move(co).call([&sum](const int&& v){ sum += v - n; });
+
+#define OPTIONAL_EXT_TIMES4(m, n) m(n) m(n + 1) m(n + 2) m(n + 3)
+#define OPTIONAL_EXT_TIMES16(m, n) OPTIONAL_EXT_TIMES4(m, n) OPTIONAL_EXT_TIMES4(m, n + 4) OPTIONAL_EXT_TIMES4(m, n + 8) OPTIONAL_EXT_TIMES4(m, n + 12)
+#define OPTIONAL_EXT_TIMES64(m, n) OPTIONAL_EXT_TIMES16(m, n) OPTIONAL_EXT_TIMES16(m, n + 16) OPTIONAL_EXT_TIMES16(m, n + 32) OPTIONAL_EXT_TIMES16(m, n + 48)
+
+int compile_bench(optional<int> o, const optional<int> co) {
+    int sum = 0;
+    OPTIONAL_EXT_TIMES64(OPTIONAL_EXT_CHAIN, 0)
+    return sum;
+}
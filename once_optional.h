@@ -0,0 +1,71 @@
+#ifndef ONCE_OPTIONAL_H
+#define ONCE_OPTIONAL_H
+#include "optional_ext.h"
+#include <atomic>
+#include <mutex>
+#include <utility>
+
+namespace knatten {
+    //An optional<T> computed on first access, e.g. a cached config value, which any number of
+    //threads may ask for at once:
+    //    const optional<int>& port = config_port.get_or_init(read_port_from_config);
+    //The first caller runs init under std::call_once, callers arriving meanwhile wait for it,
+    //and every later caller only does an acquire load of the initialised flag.
+    //
+    //Once initialised the optional never changes, so transform, transform_optional and call
+    //work on it directly and existing chains keep working. Before that they see no value.
+    template <class T>
+    class once_optional {
+    public:
+        once_optional() = default;
+        once_optional(const once_optional&) = delete;
+        once_optional& operator=(const once_optional&) = delete;
+
+        //Initialise with init() unless already done, init returns a T or an optional.
+        //If init throws, the exception propagates and the next caller runs init again.
+        template <class Init>
+        const optional<T>& get_or_init(Init&& init) {
+            if (!initialised()) {
+                std::call_once(once_, [this, &init] {
+                    value_ = detail::invoke(std::forward<Init>(init));
+                    initialised_.store(true, std::memory_order_release);
+                });
+            }
+            return value_;
+        }
+
+        bool initialised() const noexcept { return initialised_.load(std::memory_order_acquire); }
+
+        bool has_value() const noexcept { return get().has_value(); }
+
+        const T& value() const { return get().value(); }
+
+        template <class UnaryOperation>
+        auto transform(UnaryOperation&& op) const {
+            return get().transform(std::forward<UnaryOperation>(op));
+        }
+
+        template <class UnaryOperation>
+        auto transform_optional(UnaryOperation&& op) const {
+            return get().transform_optional(std::forward<UnaryOperation>(op));
+        }
+
+        template <class UnaryOperation>
+        void call(UnaryOperation&& op) const {
+            get().call(std::forward<UnaryOperation>(op));
+        }
+
+    private:
+        //The optional if initialised, otherwise an empty one
+        const optional<T>& get() const noexcept {
+            return initialised() ? value_ : empty_;
+        }
+
+        static inline const optional<T> empty_{};
+
+        std::atomic<bool> initialised_{false};
+        std::once_flag once_{};
+        optional<T> value_{};
+    };
+}
+#endif
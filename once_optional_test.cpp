@@ -0,0 +1,91 @@
+#include "once_optional.h"
+#include "catch.hpp"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::string;
+using knatten::optional;
+using knatten::once_optional;
+
+TEST_CASE("once_optional get_or_init") {
+    SECTION("initialises once") {
+        once_optional<int> o;
+        int calls = 0;
+        REQUIRE(o.initialised() == false);
+        REQUIRE(o.get_or_init([&calls]{ ++calls; return 1;}).value() == 1);
+        REQUIRE(o.get_or_init([&calls]{ ++calls; return 2;}).value() == 1);
+        REQUIRE(o.initialised() == true);
+        REQUIRE(calls == 1);
+    }
+
+    SECTION("with an optional") {
+        once_optional<string> present;
+        REQUIRE(present.get_or_init([]{ return optional<string>("foo");}).value() == "foo");
+
+        once_optional<string> absent;
+        REQUIRE(absent.get_or_init([]{ return optional<string>();}).has_value() == false);
+        REQUIRE(absent.initialised() == true);
+    }
+
+    SECTION("retries after an exception") {
+        once_optional<int> o;
+        REQUIRE_THROWS_AS(o.get_or_init([]() -> int { throw std::runtime_error("no config");}), std::runtime_error);
+        REQUIRE(o.initialised() == false);
+        REQUIRE(o.get_or_init([]{ return 3;}).value() == 3);
+    }
+
+    SECTION("from several threads") {
+        once_optional<int> o;
+        std::atomic<int> calls{0};
+        std::vector<std::thread> threads;
+        std::vector<int> seen(8);
+        for (auto& s : seen) {
+            threads.emplace_back([&o, &calls, &s]{
+                s = o.get_or_init([&calls]{ ++calls; return 42;}).value();
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        REQUIRE(calls == 1);
+        for (int s : seen) {
+            REQUIRE(s == 42);
+        }
+    }
+}
+
+TEST_CASE("once_optional transform, transform_optional and call") {
+    SECTION("before initialisation") {
+        once_optional<int> o;
+        bool called = false;
+        REQUIRE(o.has_value() == false);
+        REQUIRE_THROWS_AS(o.value(), std::bad_optional_access);
+        REQUIRE(o.transform([](int v){ return v*2;}).has_value() == false);
+        REQUIRE(o.transform_optional([](int v){ return optional(v*2);}).has_value() == false);
+        o.call([&called](int){ called = true;});
+        REQUIRE(called == false);
+    }
+
+    SECTION("after initialisation") {
+        once_optional<string> o;
+        o.get_or_init([]{ return string("foo");});
+        REQUIRE(o.value() == "foo");
+        REQUIRE(o.transform([](const string& s){ return s.size();}).value() == 3);
+        REQUIRE(o.transform_optional([](const string& s){ return optional(s + "bar");}).value() == "foobar");
+        string result;
+        o.call([&result](const string& s){ result = s;});
+        REQUIRE(result == "foo");
+    }
+
+    SECTION("chained on get_or_init") {
+        once_optional<int> o;
+        auto p = o.get_or_init([]{ return 2;})
+            .transform([](int v){ return v*3;})
+            .transform([](int v){ return v+1;});
+        REQUIRE(p.value() == 7);
+    }
+}
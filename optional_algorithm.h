@@ -0,0 +1,122 @@
+#ifndef OPTIONAL_ALGORITHM_H
+#define OPTIONAL_ALGORITHM_H
+#include "optional_ext.h"
+#include <algorithm>
+#include <cstddef>
+#include <execution>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//Algorithms over ranges of optional<T>, mirroring the member functions of optional, with
+//overloads taking a standard execution policy (std::execution::seq, par, par_unseq, ...).
+//Each element is handled independently, so empty elements are simply skipped by the worker
+//that owns them and the range is never split up by presence. With a parallel policy, op is
+//called concurrently and must be safe to call from several threads at once.
+namespace knatten {
+    namespace detail {
+        template <class ExecutionPolicy>
+        using enable_if_execution_policy_t =
+            std::enable_if_t<std::is_execution_policy_v<std::decay_t<ExecutionPolicy>>>;
+
+        //Only ranges of optionals, so that these are not found by argument-dependent lookup for
+        //other ranges with elements from namespace knatten, making std::transform etc. ambiguous
+        template <class It>
+        using enable_if_optional_iterator_t =
+            std::enable_if_t<is_optional<remove_cvref_t<typename std::iterator_traits<It>::value_type>>::value>;
+    }
+
+    //Writes first[i].transform(op) to d_first[i]
+    template <class ExecutionPolicy, class ForwardIt1, class ForwardIt2, class UnaryOperation,
+              class = detail::enable_if_execution_policy_t<ExecutionPolicy>,
+              class = detail::enable_if_optional_iterator_t<ForwardIt1>>
+    ForwardIt2 transform(ExecutionPolicy&& policy, ForwardIt1 first, ForwardIt1 last, ForwardIt2 d_first, UnaryOperation op) {
+        return std::transform(std::forward<ExecutionPolicy>(policy), first, last, d_first,
+            [&op](auto&& o) { return std::forward<decltype(o)>(o).transform(op); });
+    }
+
+    template <class InputIt, class OutputIt, class UnaryOperation,
+              class = detail::enable_if_optional_iterator_t<InputIt>>
+    OutputIt transform(InputIt first, InputIt last, OutputIt d_first, UnaryOperation op) {
+        return std::transform(first, last, d_first,
+            [&op](auto&& o) { return std::forward<decltype(o)>(o).transform(op); });
+    }
+
+    //Writes first[i].transform_optional(op) to d_first[i]
+    template <class ExecutionPolicy, class ForwardIt1, class ForwardIt2, class UnaryOperation,
+              class = detail::enable_if_execution_policy_t<ExecutionPolicy>,
+              class = detail::enable_if_optional_iterator_t<ForwardIt1>>
+    ForwardIt2 transform_optional(ExecutionPolicy&& policy, ForwardIt1 first, ForwardIt1 last, ForwardIt2 d_first, UnaryOperation op) {
+        return std::transform(std::forward<ExecutionPolicy>(policy), first, last, d_first,
+            [&op](auto&& o) { return std::forward<decltype(o)>(o).transform_optional(op); });
+    }
+
+    template <class InputIt, class OutputIt, class UnaryOperation,
+              class = detail::enable_if_optional_iterator_t<InputIt>>
+    OutputIt transform_optional(InputIt first, InputIt last, OutputIt d_first, UnaryOperation op) {
+        return std::transform(first, last, d_first,
+            [&op](auto&& o) { return std::forward<decltype(o)>(o).transform_optional(op); });
+    }
+
+    //Calls first[i].call(op) for every element
+    template <class ExecutionPolicy, class ForwardIt, class UnaryOperation,
+              class = detail::enable_if_execution_policy_t<ExecutionPolicy>,
+              class = detail::enable_if_optional_iterator_t<ForwardIt>>
+    void call(ExecutionPolicy&& policy, ForwardIt first, ForwardIt last, UnaryOperation op) {
+        std::for_each(std::forward<ExecutionPolicy>(policy), first, last,
+            [&op](auto&& o) { std::forward<decltype(o)>(o).call(op); });
+    }
+
+    template <class InputIt, class UnaryOperation,
+              class = detail::enable_if_optional_iterator_t<InputIt>>
+    void call(InputIt first, InputIt last, UnaryOperation op) {
+        std::for_each(first, last,
+            [&op](auto&& o) { std::forward<decltype(o)>(o).call(op); });
+    }
+
+    //Writes the same as transform, but for operations that are cheaper on many values at once.
+    //The present values are gathered, batch_size at a time, into a std::vector<T> which is passed
+    //to batch_op. batch_op must return a std::vector<U> with the result for each value, in the
+    //same order, and these are scattered back to the positions of the present values.
+    //Like for std::transform, d_first must have room for std::distance(first, last) elements.
+    //Throws std::invalid_argument if batch_size is 0, and std::length_error if batch_op returns
+    //the wrong number of results, in which case the output for that batch is not written.
+    template <class ForwardIt, class OutputIt, class BatchOperation,
+              class = detail::enable_if_optional_iterator_t<ForwardIt>>
+    OutputIt batch_transform(ForwardIt first, ForwardIt last, OutputIt d_first, BatchOperation batch_op,
+                             std::size_t batch_size = 256) {
+        using T = std::decay_t<decltype(**first)>;
+        using U = typename detail::invoke_result_t<BatchOperation&, const std::vector<T>&>::value_type;
+        if (batch_size == 0) {
+            throw std::invalid_argument("batch_transform: batch_size must be at least 1");
+        }
+        std::vector<T> batch;
+        batch.reserve(batch_size);
+        while (first != last) {
+            ForwardIt batch_last = first;
+            for (; batch_last != last && batch.size() < batch_size; ++batch_last) {
+                if ((*batch_last).has_value()) {
+                    batch.push_back(**batch_last);
+                }
+            }
+            if (batch.empty()) {
+                d_first = std::fill_n(d_first, std::distance(first, batch_last), optional<U>());
+            } else {
+                auto results = detail::invoke(batch_op, std::as_const(batch));
+                if (results.size() != batch.size()) {
+                    throw std::length_error("batch_transform: batch_op must return one result per value");
+                }
+                auto result = results.begin();
+                for (; first != batch_last; ++first, ++d_first) {
+                    *d_first = (*first).has_value() ? optional<U>(std::move(*result++)) : optional<U>();
+                }
+            }
+            first = batch_last;
+            batch.clear();
+        }
+        return d_first;
+    }
+}
+#endif
@@ -0,0 +1,175 @@
+#include "optional_algorithm.h"
+#include "catch.hpp"
+
+#include <atomic>
+#include <execution>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+using knatten::optional;
+
+namespace {
+    vector<optional<int>> every_other(int n) {
+        vector<optional<int>> v;
+        for (int i = 0; i < n; ++i) {
+            v.push_back(i % 2 ? optional(i) : optional<int>());
+        }
+        return v;
+    }
+}
+
+TEST_CASE("transform algorithm") {
+    auto in = every_other(10000);
+
+    SECTION("sequential") {
+        vector<optional<int>> out(in.size());
+        knatten::transform(in.begin(), in.end(), out.begin(), [](int i){ return i*2;});
+        REQUIRE(out[0].has_value() == false);
+        REQUIRE(out[9999].value() == 19998);
+    }
+
+    SECTION("with execution policies") {
+        vector<optional<long>> seq(in.size());
+        vector<optional<long>> par(in.size());
+        vector<optional<long>> par_unseq(in.size());
+        auto op = [](int i){ return long(i)*3;};
+        knatten::transform(std::execution::seq, in.begin(), in.end(), seq.begin(), op);
+        knatten::transform(std::execution::par, in.begin(), in.end(), par.begin(), op);
+        knatten::transform(std::execution::par_unseq, in.begin(), in.end(), par_unseq.begin(), op);
+        for (std::size_t i = 0; i < in.size(); ++i) {
+            REQUIRE(seq[i].has_value() == in[i].has_value());
+            REQUIRE(par[i].has_value() == in[i].has_value());
+            REQUIRE(par_unseq[i].has_value() == in[i].has_value());
+        }
+        REQUIRE(par[9999].value() == 29997);
+    }
+
+    SECTION("with rvalues") {
+        vector<optional<string>> strings{string("foo"), optional<string>()};
+        vector<optional<std::size_t>> out(2);
+        knatten::transform(std::make_move_iterator(strings.begin()), std::make_move_iterator(strings.end()), out.begin(),
+            [](string&& s){ return s.size();});
+        REQUIRE(out[0].value() == 3);
+        REQUIRE(out[1].has_value() == false);
+    }
+}
+
+TEST_CASE("transform_optional algorithm") {
+    auto in = every_other(1000);
+    vector<optional<int>> out(in.size());
+    knatten::transform_optional(std::execution::par, in.begin(), in.end(), out.begin(),
+        [](int i){ return i % 3 == 0 ? optional(i) : optional<int>();});
+    REQUIRE(out[2].has_value() == false);
+    REQUIRE(out[3].value() == 3);
+    REQUIRE(out[5].has_value() == false);
+
+    vector<optional<int>> seq(in.size());
+    knatten::transform_optional(in.begin(), in.end(), seq.begin(), [](int i){ return optional(i);});
+    REQUIRE(seq[999].value() == 999);
+}
+
+TEST_CASE("call algorithm") {
+    auto in = every_other(1000);
+    std::atomic<int> calls{0};
+    knatten::call(std::execution::par, in.begin(), in.end(), [&calls](int){ ++calls;});
+    REQUIRE(calls == 500);
+
+    int sum = 0;
+    knatten::call(in.begin(), in.begin() + 4, [&sum](int i){ sum += i;});
+    REQUIRE(sum == 4);
+}
+
+TEST_CASE("algorithms only take ranges of optionals") {
+    //The elements are from namespace knatten, so its algorithms are found by argument-dependent
+    //lookup, but must not compete with std::transform
+    using std::transform;
+    vector<std::pair<optional<int>, int>> in{{optional(1), 2}, {optional<int>(), 3}};
+    vector<int> out(in.size());
+    transform(in.begin(), in.end(), out.begin(), [](const auto& p){ return p.second;});
+    REQUIRE(out == vector<int>{2, 3});
+}
+
+TEST_CASE("batch_transform algorithm") {
+    auto doubled = [](const vector<int>& keys) {
+        vector<int> results;
+        for (int k : keys) {
+            results.push_back(k * 2);
+        }
+        return results;
+    };
+
+    SECTION("with values and no values") {
+        auto in = every_other(10);
+        vector<optional<int>> out(in.size());
+        auto end = knatten::batch_transform(in.begin(), in.end(), out.begin(), doubled);
+        REQUIRE(end == out.end());
+        for (int i = 0; i < 10; ++i) {
+            REQUIRE(out[i].has_value() == (i % 2 == 1));
+            if (i % 2) {
+                REQUIRE(out[i].value() == i * 2);
+            }
+        }
+    }
+
+    SECTION("in batches") {
+        auto in = every_other(1000);
+        vector<optional<int>> out;
+        vector<std::size_t> batch_sizes;
+        knatten::batch_transform(in.begin(), in.end(), std::back_inserter(out),
+            [&](const vector<int>& keys) { batch_sizes.push_back(keys.size()); return doubled(keys); }, 128);
+        REQUIRE(out.size() == 1000);
+        REQUIRE(out[999].value() == 1998);
+        REQUIRE(out[998].has_value() == false);
+        REQUIRE(batch_sizes == vector<std::size_t>{128, 128, 128, 116});
+    }
+
+    SECTION("changing type") {
+        vector<optional<string>> in{ optional<string>("foo"), optional<string>(), optional<string>("quux") };
+        vector<optional<std::size_t>> out(in.size());
+        knatten::batch_transform(in.begin(), in.end(), out.begin(), [](const vector<string>& keys) {
+            vector<std::size_t> sizes;
+            for (auto& k : keys) {
+                sizes.push_back(k.size());
+            }
+            return sizes;
+        });
+        REQUIRE(out[0].value() == 3);
+        REQUIRE(out[1].has_value() == false);
+        REQUIRE(out[2].value() == 4);
+    }
+
+    SECTION("with no values") {
+        vector<optional<int>> in(5);
+        vector<optional<int>> out(5, optional(1));
+        bool called = false;
+        knatten::batch_transform(in.begin(), in.end(), out.begin(),
+            [&](const vector<int>& keys) { called = true; return keys; });
+        REQUIRE(called == false);
+        for (auto& o : out) {
+            REQUIRE(o.has_value() == false);
+        }
+    }
+
+    SECTION("with batch_size 0") {
+        auto in = every_other(10);
+        vector<optional<int>> out(in.size());
+        REQUIRE_THROWS_AS(knatten::batch_transform(in.begin(), in.end(), out.begin(), doubled, 0),
+                          std::invalid_argument);
+    }
+
+    SECTION("with too few or too many results") {
+        auto in = every_other(10);
+        vector<optional<int>> out(in.size());
+        auto too_few = [&](const vector<int>& keys) { auto r = doubled(keys); r.pop_back(); return r; };
+        REQUIRE_THROWS_AS(knatten::batch_transform(in.begin(), in.end(), out.begin(), too_few),
+                          std::length_error);
+        auto too_many = [&](const vector<int>& keys) { auto r = doubled(keys); r.push_back(0); return r; };
+        REQUIRE_THROWS_AS(knatten::batch_transform(in.begin(), in.end(), out.begin(), too_many),
+                          std::length_error);
+        REQUIRE(out[1].has_value() == false);
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef OPTIONAL_ASYNC_H
+#define OPTIONAL_ASYNC_H
+#include "optional_ext.h"
+#include <exception>
+#include <future>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+//Asynchronous versions of transform and transform_optional, for operations that block on I/O,
+//like a lookup in a remote service:
+//    std::future<optional<author>> a = transform_async(pool, find_first("foo"), lookup_author);
+//If the optional has a value, it is moved or copied into a task together with op, and the task
+//is handed to the executor, which can be any callable taking a copyable, nullary function object,
+//e.g. a thread pool's post function. If it has no value, nothing is scheduled and the returned
+//future is ready right away. An exception thrown by op is rethrown by the future's get().
+namespace knatten {
+    namespace detail {
+        template <class R>
+        std::future<R> ready_future(R value) {
+            std::promise<R> promise;
+            promise.set_value(std::move(value));
+            return promise.get_future();
+        }
+
+        template <class R, class Executor, class Task>
+        std::future<R> schedule(Executor& executor, Task&& task) {
+            auto promise = std::make_shared<std::promise<R>>();
+            std::future<R> result = promise->get_future();
+            executor([promise, task = std::forward<Task>(task)]() mutable {
+                try {
+                    promise->set_value(task());
+                } catch (...) {
+                    promise->set_exception(std::current_exception());
+                }
+            });
+            return result;
+        }
+
+        template <class OptionalType>
+        using async_value_t = std::decay_t<decltype(*std::declval<OptionalType>())>;
+    }
+
+    //A future of o.transform(op), with op run on executor
+    template <class Executor, class OptionalType, class UnaryOperation,
+              std::enable_if_t<detail::is_optional<detail::remove_cvref_t<OptionalType>>::value, int> = 0>
+    auto transform_async(Executor&& executor, OptionalType&& o, UnaryOperation&& op) {
+        using T = detail::async_value_t<OptionalType>;
+        using U = detail::remove_cvref_t<detail::invoke_result_t<std::decay_t<UnaryOperation>&, T&&>>;
+        if (!o.has_value()) {
+            return detail::ready_future(optional<U>());
+        }
+        return detail::schedule<optional<U>>(executor,
+            [op = std::forward<UnaryOperation>(op), value = T(*std::forward<OptionalType>(o))]() mutable {
+                return optional<U>(in_place_invoke, op, std::move(value));
+            });
+    }
+
+    //A future of o.transform_optional(op), with op run on executor
+    template <class Executor, class OptionalType, class UnaryOperation,
+              std::enable_if_t<detail::is_optional<detail::remove_cvref_t<OptionalType>>::value, int> = 0>
+    auto transform_optional_async(Executor&& executor, OptionalType&& o, UnaryOperation&& op) {
+        using T = detail::async_value_t<OptionalType>;
+        using R = detail::remove_cvref_t<detail::invoke_result_t<std::decay_t<UnaryOperation>&, T&&>>;
+        if (!o.has_value()) {
+            return detail::ready_future(R());
+        }
+        return detail::schedule<R>(executor,
+            [op = std::forward<UnaryOperation>(op), value = T(*std::forward<OptionalType>(o))]() mutable {
+                return detail::invoke(op, std::move(value));
+            });
+    }
+}
+#endif
@@ -0,0 +1,110 @@
+#include "optional_async.h"
+#include "catch.hpp"
+
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::string;
+using knatten::optional;
+using knatten::transform_async;
+using knatten::transform_optional_async;
+
+namespace {
+    //Runs every task on a thread of its own, and counts them
+    struct thread_executor {
+        int& scheduled;
+        std::vector<std::thread>& threads;
+
+        void operator()(std::function<void()> task) {
+            ++scheduled;
+            threads.emplace_back(std::move(task));
+        }
+    };
+
+    struct executor_fixture {
+        int scheduled = 0;
+        std::vector<std::thread> threads{};
+
+        thread_executor executor() { return thread_executor{scheduled, threads}; }
+
+        ~executor_fixture() {
+            for (auto& t : threads) {
+                t.join();
+            }
+        }
+    };
+}
+
+TEST_CASE("transform_async") {
+    executor_fixture f;
+
+    SECTION("with lvalue") {
+        optional<string> o("foo");
+        auto p = transform_async(f.executor(), o, [](const string& s){ return s.size();});
+        REQUIRE(p.get().value() == 3);
+        REQUIRE(o.value() == "foo");
+        REQUIRE(f.scheduled == 1);
+    }
+
+    SECTION("with rvalue") {
+        auto p = transform_async(f.executor(), optional<string>("foo"), [](string&& s){ return s + "bar";});
+        REQUIRE(p.get().value() == "foobar");
+    }
+
+    SECTION("with no value") {
+        auto p = transform_async(f.executor(), optional<int>(), [](int v){ return v*2;});
+        REQUIRE(p.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+        REQUIRE(p.get().has_value() == false);
+        REQUIRE(f.scheduled == 0);
+    }
+
+    SECTION("with a throwing op") {
+        auto p = transform_async(f.executor(), optional(1), [](int) -> int { throw std::runtime_error("unavailable");});
+        REQUIRE_THROWS_AS(p.get(), std::runtime_error);
+    }
+
+    SECTION("with an inline executor") {
+        auto inline_executor = [](auto task) { task(); };
+        auto p = transform_async(inline_executor, optional(2), [](int v){ return v*2;});
+        REQUIRE(p.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+        REQUIRE(p.get().value() == 4);
+    }
+}
+
+TEST_CASE("transform_optional_async") {
+    executor_fixture f;
+
+    SECTION("with value") {
+        auto p = transform_optional_async(f.executor(), optional(2), [](int v){ return optional(v*3);});
+        REQUIRE(p.get().value() == 6);
+        REQUIRE(f.scheduled == 1);
+    }
+
+    SECTION("op returning no value") {
+        auto p = transform_optional_async(f.executor(), optional(2), [](int){ return optional<int>();});
+        REQUIRE(p.get().has_value() == false);
+    }
+
+    SECTION("with no value") {
+        auto p = transform_optional_async(f.executor(), optional<int>(), [](int v){ return optional(v);});
+        REQUIRE(p.get().has_value() == false);
+        REQUIRE(f.scheduled == 0);
+    }
+
+    SECTION("several lookups in flight") {
+        std::vector<std::future<optional<int>>> results;
+        for (int i = 0; i < 4; ++i) {
+            results.push_back(transform_optional_async(f.executor(), optional(i),
+                [](int v){ return v % 2 == 0 ? optional(v*10) : optional<int>();}));
+        }
+        REQUIRE(results[0].get().value() == 0);
+        REQUIRE(results[1].get().has_value() == false);
+        REQUIRE(results[2].get().value() == 20);
+        REQUIRE(results[3].get().has_value() == false);
+        REQUIRE(f.scheduled == 4);
+    }
+}
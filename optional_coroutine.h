@@ -0,0 +1,170 @@
+#ifndef OPTIONAL_COROUTINE_H
+#define OPTIONAL_COROUTINE_H
+#include "optional_ext.h"
+
+#if !defined(__cpp_impl_coroutine)
+#error "optional_coroutine.h requires C++20 coroutines"
+#endif
+
+#include <coroutine>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+//Lets a function returning optional<T> be a coroutine which co_awaits other optionals,
+//returning an empty optional as soon as one of them is empty:
+//    optional<author> original_author(const string& s) {
+//        tweet t = co_await find_first(s);
+//        tweet replied_to = co_await tweet_replied_to(t);
+//        co_return lookup_author(replied_to);
+//    }
+//co_await on an lvalue optional gives a reference to its value, on an rvalue the value
+//moved out of it. co_return takes anything optional<T> can be assigned from, including
+//std::nullopt.
+//
+//The coroutine never suspends, it either runs to completion or is destroyed when awaiting an
+//empty optional. Its frame is still allocated, unless the compiler elides the allocation (HALO),
+//which GCC does not do, so frames are recycled through a small per thread cache instead.
+namespace knatten {
+    namespace detail {
+        //Per thread cache of freed coroutine frames. The frame of a given coroutine always has the
+        //same size, so a block is only reused for a frame of exactly the same size.
+        class coroutine_frame_cache {
+        public:
+            static void* allocate(std::size_t size) {
+                if (!destroyed()) {
+                    auto& cache = instance();
+                    for (std::size_t i = cache.count_; i-- > 0;) {
+                        if (cache.blocks_[i].size == size) {
+                            void* p = cache.blocks_[i].p;
+                            cache.blocks_[i] = cache.blocks_[--cache.count_];
+                            return p;
+                        }
+                    }
+                }
+                return ::operator new(size);
+            }
+
+            static void deallocate(void* p, std::size_t size) noexcept {
+                if (destroyed() || instance().count_ == slots) {
+                    ::operator delete(p, size);
+                    return;
+                }
+                auto& cache = instance();
+                cache.blocks_[cache.count_++] = block{p, size};
+            }
+
+            coroutine_frame_cache() = default;
+            coroutine_frame_cache(const coroutine_frame_cache&) = delete;
+            coroutine_frame_cache& operator=(const coroutine_frame_cache&) = delete;
+
+            ~coroutine_frame_cache() {
+                for (std::size_t i = 0; i < count_; ++i) {
+                    ::operator delete(blocks_[i].p, blocks_[i].size);
+                }
+                destroyed() = true;
+            }
+
+        private:
+            static constexpr std::size_t slots = 16;
+
+            struct block {
+                void* p;
+                std::size_t size;
+            };
+
+            static coroutine_frame_cache& instance() {
+                thread_local coroutine_frame_cache cache;
+                return cache;
+            }
+
+            //Set once this thread's cache is gone, for coroutines run during thread teardown
+            static bool& destroyed() noexcept {
+                thread_local bool d = false;
+                return d;
+            }
+
+            block blocks_[slots] = {};
+            std::size_t count_ = 0;
+        };
+
+        //What get_return_object returns. It holds the result and keeps the promise pointing at it
+        //when it is moved, relying on the conversion to the optional<T> the function returns
+        //happening only once the coroutine has finished or been destroyed. The standard leaves
+        //that timing unspecified. GCC converts late, which is checked by the tests with GCC 12,
+        //but on other compilers it is an assumption.
+        template <class T>
+        class optional_return_object {
+        public:
+            explicit optional_return_object(optional<T>*& slot) : result_(), slot_(slot) { slot_ = &result_; }
+
+            optional_return_object(optional_return_object&& rhs)
+                : result_(std::move(rhs.result_)), slot_(rhs.slot_) { slot_ = &result_; }
+
+            optional_return_object(const optional_return_object&) = delete;
+            optional_return_object& operator=(const optional_return_object&) = delete;
+
+            operator optional<T>() && { return std::move(result_); }
+
+        private:
+            optional<T> result_;
+            optional<T>*& slot_;
+        };
+
+        template <class Optional>
+        struct optional_awaiter {
+            using value_type = std::conditional_t<std::is_lvalue_reference_v<Optional>,
+                decltype(*std::declval<Optional>()),
+                remove_cvref_t<decltype(*std::declval<Optional>())>>;
+
+            Optional&& o;
+
+            bool await_ready() const noexcept { return o.has_value(); }
+
+            //Only reached when o is empty. Destroying the coroutine returns to its caller, whose
+            //optional_return_object was never given a value.
+            template <class Promise>
+            void await_suspend(std::coroutine_handle<Promise> h) const noexcept { h.destroy(); }
+
+            value_type await_resume() const { return *std::forward<Optional>(o); }
+        };
+
+        template <class T>
+        class optional_promise {
+        public:
+            optional_promise() = default;
+            optional_promise(const optional_promise&) = delete;
+            optional_promise& operator=(const optional_promise&) = delete;
+
+            static void* operator new(std::size_t size) { return coroutine_frame_cache::allocate(size); }
+            static void operator delete(void* p, std::size_t size) noexcept { coroutine_frame_cache::deallocate(p, size); }
+
+            optional_return_object<T> get_return_object() { return optional_return_object<T>(slot_); }
+
+            std::suspend_never initial_suspend() const noexcept { return {}; }
+            std::suspend_never final_suspend() const noexcept { return {}; }
+
+            template <class U = T>
+            void return_value(U&& v) { *slot_ = std::forward<U>(v); }
+
+            //The coroutine has not returned to its caller yet, so the exception can simply propagate
+            //to it, and the frame is destroyed on the way out
+            void unhandled_exception() const { throw; }
+
+            template <class Optional, std::enable_if_t<is_optional<remove_cvref_t<Optional>>::value, int> = 0>
+            optional_awaiter<Optional> await_transform(Optional&& o) const noexcept {
+                return optional_awaiter<Optional>{std::forward<Optional>(o)};
+            }
+
+        private:
+            optional<T>* slot_ = nullptr;
+        };
+    }
+}
+
+template <class T, class... Args>
+struct std::coroutine_traits<knatten::optional<T>, Args...> {
+    using promise_type = knatten::detail::optional_promise<T>;
+};
+#endif
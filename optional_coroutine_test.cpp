@@ -0,0 +1,129 @@
+#include "optional_coroutine.h"
+#include "catch.hpp"
+#include "probe.h"
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+using std::string;
+using knatten::optional;
+
+namespace {
+    optional<int> half(int v) {
+        return v % 2 == 0 ? optional(v / 2) : optional<int>();
+    }
+
+    optional<int> quarter(int v) {
+        int h = co_await half(v);
+        co_return co_await half(h);
+    }
+
+    optional<int> eighth(int v) {
+        int q = co_await quarter(v);
+        co_return co_await half(q);
+    }
+
+    optional<string> describe(const optional<int>& o) {
+        const int& v = co_await o;
+        co_return std::to_string(v);
+    }
+
+    optional<int> nothing_if_negative(int v) {
+        if (v < 0) {
+            co_return std::nullopt;
+        }
+        co_return v;
+    }
+
+    optional<int> throws_on(int v) {
+        int h = co_await half(v);
+        if (h == 1) {
+            throw std::runtime_error("one");
+        }
+        co_return h;
+    }
+
+    //Runs a coroutine when the thread exits, after its frame cache, which is only created later,
+    //has been destroyed
+    struct at_thread_exit {
+        optional<int>& result;
+        ~at_thread_exit() { result = eighth(16); }
+    };
+}
+
+TEST_CASE("co_await") {
+    SECTION("with values") {
+        REQUIRE(quarter(8).value() == 2);
+        REQUIRE(eighth(16).value() == 2);
+    }
+
+    SECTION("short-circuits on no value") {
+        REQUIRE(quarter(6).has_value() == false);
+        REQUIRE(quarter(7).has_value() == false);
+        REQUIRE(eighth(12).has_value() == false);
+
+        int calls = 0;
+        auto count = [&calls](int v) -> optional<int> {
+            co_await half(v);
+            ++calls;
+            co_return v;
+        };
+        REQUIRE(count(3).has_value() == false);
+        REQUIRE(calls == 0);
+    }
+
+    SECTION("lvalue") {
+        optional<int> o(3);
+        REQUIRE(describe(o).value() == "3");
+        REQUIRE(describe(optional<int>()).has_value() == false);
+    }
+
+    SECTION("co_return nullopt") {
+        REQUIRE(nothing_if_negative(1).value() == 1);
+        REQUIRE(nothing_if_negative(-1).has_value() == false);
+    }
+
+    SECTION("exceptions") {
+        REQUIRE_THROWS_AS(throws_on(2), std::runtime_error);
+        REQUIRE(throws_on(4).value() == 2);
+        REQUIRE(throws_on(3).has_value() == false);
+    }
+
+    SECTION("mixed with transform") {
+        auto p = quarter(8).transform([](int v){ return v*10;});
+        REQUIRE(p.value() == 20);
+    }
+
+    SECTION("during thread teardown") {
+        optional<int> before;
+        optional<int> result;
+        std::thread([&before, &result] {
+            thread_local at_thread_exit e{result};
+            before = quarter(8);
+        }).join();
+        REQUIRE(before.value() == 2);
+        REQUIRE(result.value() == 2);
+    }
+}
+
+TEST_CASE("co_await copies and moves") {
+    auto pass_on = [](optional<probe> o) -> optional<probe> {
+        probe p = co_await std::move(o);
+        co_return std::move(p);
+    };
+    auto by_reference = [](const optional<probe>& o) -> optional<int> {
+        const probe& p = co_await o;
+        co_return p.value;
+    };
+
+    optional<probe> o(std::in_place, 1);
+    probe::reset();
+    REQUIRE(by_reference(o).value() == 1);
+    REQUIRE(probe::count().copies == 0);
+    REQUIRE(probe::count().moves == 0);
+
+    probe::reset();
+    REQUIRE(pass_on(std::move(o))->value == 1);
+    REQUIRE(probe::count().copies == 0);
+}
@@ -1,109 +1,684 @@
 #ifndef OPTIONAL_EXT_H
 #define OPTIONAL_EXT_H
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <new>
 #include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#if defined(__cpp_explicit_this_parameter) && __cpp_explicit_this_parameter >= 202110L
+#define KNATTEN_OPTIONAL_DEDUCING_THIS
+#endif
+
+//Define KNATTEN_OPTIONAL_CONDITIONAL_NOEXCEPT to make transform, transform_optional, call and
+//transform_in_place noexcept whenever calling op, and for transform constructing the result,
+//cannot throw, and the move constructor noexcept only when moving the stored T can't throw. The
+//proposal leaves them unmarked (see "noexcept specifiers" in proposal.md), so this is opt-in.
+//Define it for the whole program or not at all, as it changes the type of the functions.
+#ifdef KNATTEN_OPTIONAL_CONDITIONAL_NOEXCEPT
+#define KNATTEN_OPTIONAL_NOEXCEPT_IF(...) noexcept(__VA_ARGS__)
+#else
+#define KNATTEN_OPTIONAL_NOEXCEPT_IF(...)
+#endif
 
 namespace knatten {
+    //Specialise niche_traits<T> to let optional<T> represent "no value" with a value of T
+    //that never occurs in practice, so that sizeof(optional<T>) == sizeof(T).
+    //An enabled specialisation provides:
+    //    static constexpr bool enabled = true;
+    //    static T empty_value() noexcept;                //The niche
+    //    static bool is_empty(const T& v) noexcept;      //Whether v is the niche
+    //Note that optional<T>(empty_value()) then has no value. Only specialise it for types you own,
+    //as every translation unit using optional<T> must see the same specialisation.
+    //Ready-made policies for the common cases follow below, e.g.
+    //    template <> struct knatten::niche_traits<node*> : knatten::null_pointer_niche<node*> { };
+    template <class T>
+    struct niche_traits {
+        static constexpr bool enabled = false;
+    };
+
+    //Null pointers as the niche, for pointers that are never legitimately null
+    template <class T>
+    struct null_pointer_niche {
+        static_assert(std::is_pointer_v<T>, "null_pointer_niche requires a pointer type");
+        static constexpr bool enabled = true;
+        static constexpr T empty_value() noexcept { return nullptr; }
+        static constexpr bool is_empty(const T& v) noexcept { return v == nullptr; }
+    };
+
+    //A single user-declared value as the niche, e.g. a max index or an out-of-range enumerator
+    template <class T, T Sentinel>
+    struct sentinel_niche {
+        static constexpr bool enabled = true;
+        static constexpr T empty_value() noexcept { return Sentinel; }
+        static constexpr bool is_empty(const T& v) noexcept { return v == Sentinel; }
+    };
+
+    //A quiet NaN with a distinctive payload as the niche. Other NaNs, including the
+    //ones produced by arithmetic, are still stored as values.
+    template <class T>
+    struct nan_niche {
+        static_assert(std::numeric_limits<T>::is_iec559 && (sizeof(T) == 4 || sizeof(T) == 8),
+                      "nan_niche requires an IEEE 754 float or double");
+        using bits_type = std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>;
+        static constexpr bits_type empty_bits = sizeof(T) == 4 ?
+            bits_type(0x7fc00a5eu) :
+            bits_type(0x7ff8000000000a5eull);
+
+        static constexpr bool enabled = true;
+        static T empty_value() noexcept {
+            T v;
+            std::memcpy(&v, &empty_bits, sizeof(T));
+            return v;
+        }
+        static bool is_empty(const T& v) noexcept {
+            bits_type bits;
+            std::memcpy(&bits, &v, sizeof(T));
+            return bits == empty_bits;
+        }
+    };
+
+    //Specialise box_traits<T> to store the value of optional<T> out of line, in a block from a
+    //per thread pool, so that sizeof(optional<T>) == sizeof(T*). Meant for large T in mostly
+    //empty optionals, where inline storage would bloat every container holding them.
+    //An enabled specialisation provides:
+    //    static constexpr bool enabled = true;
+    //    static constexpr std::size_t pool_size;        //Free blocks kept per thread
+    //Moving from such an optional leaves it empty, and an rvalue transform empties its source
+    //as soon as op has run, handing the block back to the pool for the next allocation.
+    //    template <> struct knatten::box_traits<record> : knatten::pooled_box<> { };
+    template <class T>
+    struct box_traits {
+        static constexpr bool enabled = false;
+    };
+
+    template <std::size_t PoolSize = 64>
+    struct pooled_box {
+        static constexpr bool enabled = true;
+        static constexpr std::size_t pool_size = PoolSize;
+    };
+
+    //Tag for constructing the value of an optional in place from the result of a function call
+    struct in_place_invoke_t {
+        explicit in_place_invoke_t() = default;
+    };
+    inline constexpr in_place_invoke_t in_place_invoke{};
+
+    namespace detail {
+        template <class T>
+        using remove_cvref_t = std::remove_cv_t<std::remove_reference_t<T>>;
+
+        //std::invoke, but calling anything that is not a member pointer directly, which is
+        //noticeably cheaper to compile than going through std::invoke for every lambda
+        template <class F, class... Args>
+        constexpr decltype(auto) invoke(F&& f, Args&&... args) {
+            return std::forward<F>(f)(std::forward<Args>(args)...);
+        }
+
+        template <class M, class C, class... Args>
+        constexpr decltype(auto) invoke(M C::* f, Args&&... args) {
+            return std::invoke(f, std::forward<Args>(args)...);
+        }
+
+        //std::invoke_result_t, only much cheaper to compile
+        template <class F, class... Args>
+        using invoke_result_t = decltype(detail::invoke(std::declval<F>(), std::declval<Args>()...));
+
+        //Whether f(std::move(v)) returns something to assign back to v, rather than f modifying
+        //v through a reference and returning void
+        template <class F, class T, class = void>
+        struct returns_replacement : std::false_type { };
+
+        template <class F, class T>
+        struct returns_replacement<F, T, std::enable_if_t<!std::is_void_v<std::invoke_result_t<F, T&&>>>> : std::true_type { };
+
+        template <class F, class T>
+        constexpr bool is_nothrow_transform_in_place() {
+            if constexpr (returns_replacement<F, T>::value) {
+                return std::is_nothrow_invocable_v<F, T&&> &&
+                       std::is_nothrow_assignable_v<T&, std::invoke_result_t<F, T&&>>;
+            } else {
+                return std::is_nothrow_invocable_v<F, T&>;
+            }
+        }
+
+        //Converts to the result of f(args...). Passing one of these to an in-place constructor
+        //makes the value be initialised straight from the prvalue f returns, with no move.
+        template <class F, class... Args>
+        struct invoke_result_converter {
+            using result_type = detail::invoke_result_t<F, Args...>;
+
+            constexpr operator result_type() const {
+                return call(std::index_sequence_for<Args...>());
+            }
+
+            template <std::size_t... I>
+            constexpr result_type call(std::index_sequence<I...>) const {
+                return detail::invoke(std::forward<F>(f), std::forward<Args>(std::get<I>(args))...);
+            }
+
+            F& f;
+            std::tuple<Args&&...> args;
+        };
+
+        //A type nothing should be constructible from. A T that is constructible from it anyway
+        //has a constructor template that would swallow an invoke_result_converter itself.
+        struct unrelated_type { };
+
+        template <class T>
+        inline constexpr bool is_constructible_from_anything = std::is_constructible_v<T, unrelated_type>;
+
+        //Storage for a T with an enabled niche_traits<T>, mirroring the parts of std::optional that optional uses
+        template <class T>
+        class niche_storage {
+            using traits = niche_traits<T>;
+        public:
+            constexpr niche_storage() noexcept : v_(traits::empty_value()) { }
+            constexpr niche_storage(T val) noexcept(std::is_nothrow_move_constructible_v<T>) : v_(std::move(val)) { }
+
+            template <class... Args>
+            constexpr explicit niche_storage(std::in_place_t, Args&&... args) : v_(std::forward<Args>(args)...) { }
+
+            template <class... Args>
+            constexpr T& emplace(Args&&... args) {
+                v_ = T(std::forward<Args>(args)...);
+                return v_;
+            }
+
+            constexpr void reset() noexcept { v_ = traits::empty_value(); }
+
+            constexpr bool has_value() const noexcept { return !traits::is_empty(v_); }
+
+            constexpr const T& value() const& { check(); return v_; }
+            constexpr T& value() & { check(); return v_; }
+            constexpr T&& value() && { check(); return std::move(v_); }
+            constexpr const T&& value() const&& { check(); return std::move(v_); }
+
+            constexpr const T& operator*() const& { return v_; }
+            constexpr T& operator*() & { return v_; }
+            constexpr const T&& operator*() const&& { return std::move(v_); }
+            constexpr T&& operator*() && { return std::move(v_); }
+
+            constexpr const T* operator->() const { return &v_; }
+            constexpr T* operator->() { return &v_; }
+
+        private:
+            constexpr void check() const {
+                if (!has_value()) {
+                    throw std::bad_optional_access();
+                }
+            }
+
+            T v_;
+        };
+
+        //Per thread free list of blocks for a T, used by box_storage
+        template <class T>
+        class box_pool {
+        public:
+            static void* allocate() {
+                if (!destroyed()) {
+                    auto& pool = instance();
+                    if (pool.free_ != nullptr) {
+                        block* b = pool.free_;
+                        pool.free_ = b->next;
+                        --pool.count_;
+                        return b;
+                    }
+                }
+                return new block;
+            }
+
+            static void deallocate(void* p) noexcept {
+                block* b = static_cast<block*>(p);
+                if (destroyed() || instance().count_ == box_traits<T>::pool_size) {
+                    delete b;
+                    return;
+                }
+                auto& pool = instance();
+                b->next = pool.free_;
+                pool.free_ = b;
+                ++pool.count_;
+            }
+
+            box_pool() = default;
+            box_pool(const box_pool&) = delete;
+            box_pool& operator=(const box_pool&) = delete;
+
+            ~box_pool() {
+                while (free_ != nullptr) {
+                    delete std::exchange(free_, free_->next);
+                }
+                destroyed() = true;
+            }
+
+        private:
+            union block {
+                block* next;
+                alignas(T) unsigned char storage[sizeof(T)];
+            };
+
+            static box_pool& instance() {
+                thread_local box_pool pool;
+                return pool;
+            }
+
+            //Set once this thread's pool is gone, for optionals destroyed after that
+            static bool& destroyed() noexcept {
+                thread_local bool d = false;
+                return d;
+            }
+
+            block* free_ = nullptr;
+            std::size_t count_ = 0;
+        };
+
+        //Storage for a T with an enabled box_traits<T>, mirroring the parts of std::optional that optional uses
+        template <class T>
+        class box_storage {
+            using pool = box_pool<T>;
+        public:
+            constexpr box_storage() noexcept = default;
+            box_storage(T val) : p_(make(std::move(val))) { }
+
+            template <class... Args>
+            explicit box_storage(std::in_place_t, Args&&... args) : p_(make(std::forward<Args>(args)...)) { }
+
+            box_storage(const box_storage& rhs) : p_(rhs.p_ != nullptr ? make(*rhs.p_) : nullptr) { }
+            box_storage(box_storage&& rhs) noexcept : p_(std::exchange(rhs.p_, nullptr)) { }
+
+            box_storage& operator=(const box_storage& rhs) {
+                if (rhs.p_ == nullptr) {
+                    reset();
+                } else if (p_ != nullptr) {
+                    *p_ = *rhs.p_;
+                } else {
+                    p_ = make(*rhs.p_);
+                }
+                return *this;
+            }
+
+            box_storage& operator=(box_storage&& rhs) noexcept {
+                if (this != &rhs) {
+                    reset();
+                    p_ = std::exchange(rhs.p_, nullptr);
+                }
+                return *this;
+            }
+
+            ~box_storage() { reset(); }
+
+            template <class... Args>
+            T& emplace(Args&&... args) {
+                reset();
+                p_ = make(std::forward<Args>(args)...);
+                return *p_;
+            }
+
+            void reset() noexcept {
+                if (p_ != nullptr) {
+                    p_->~T();
+                    pool::deallocate(std::exchange(p_, nullptr));
+                }
+            }
+
+            bool has_value() const noexcept { return p_ != nullptr; }
+
+            const T& value() const& { check(); return *p_; }
+            T& value() & { check(); return *p_; }
+            T&& value() && { check(); return std::move(*p_); }
+            const T&& value() const&& { check(); return std::move(*p_); }
+
+            const T& operator*() const& { return *p_; }
+            T& operator*() & { return *p_; }
+            const T&& operator*() const&& { return std::move(*p_); }
+            T&& operator*() && { return std::move(*p_); }
+
+            const T* operator->() const { return p_; }
+            T* operator->() { return p_; }
+
+        private:
+            template <class... Args>
+            static T* make(Args&&... args) {
+                void* block = pool::allocate();
+                try {
+                    return ::new (block) T(std::forward<Args>(args)...);
+                } catch (...) {
+                    pool::deallocate(block);
+                    throw;
+                }
+            }
+
+            void check() const {
+                if (p_ == nullptr) {
+                    throw std::bad_optional_access();
+                }
+            }
+
+            T* p_ = nullptr;
+        };
+
+        template <class T>
+        inline constexpr bool is_boxed = box_traits<T>::enabled && !niche_traits<T>::enabled;
+
+        template <class T>
+        using storage_t = std::conditional_t<niche_traits<T>::enabled, niche_storage<T>,
+            std::conditional_t<box_traits<T>::enabled, box_storage<T>, std::optional<T>>>;
+
+        //Whether transform can construct its result from R, what op returns, without throwing.
+        //A prvalue initialises the value directly (see make_storage), so only a reference, or a
+        //Result with a constructor template taking anything, is copied or moved into place. A
+        //boxed Result needs a block, and allocating one may throw std::bad_alloc.
+        template <class Result, class R>
+        inline constexpr bool is_nothrow_result_construction = !is_boxed<Result> &&
+            ((!std::is_reference_v<R> && !is_constructible_from_anything<Result>) ||
+             std::is_nothrow_constructible_v<Result, R>);
+
+        template <class F, class V>
+        inline constexpr bool is_nothrow_transform =
+            std::is_nothrow_invocable_v<F, V> &&
+            is_nothrow_result_construction<remove_cvref_t<std::invoke_result_t<F, V>>, std::invoke_result_t<F, V>>;
+    }
+
+    template <class T>
+    class optional;
+
+    namespace detail {
+        template <class T>
+        struct is_optional : std::false_type { };
+
+        template <class T>
+        struct is_optional<optional<T>> : std::true_type { };
+
+        //Whether T can be constructed or converted from some form of optional<U>, in which case
+        //converting from an optional<U> must not unwrap it (same rules as std::optional)
+        template <class T, class U>
+        inline constexpr bool converts_from_optional =
+            std::is_constructible_v<T, optional<U>&> ||
+            std::is_constructible_v<T, const optional<U>&> ||
+            std::is_constructible_v<T, optional<U>&&> ||
+            std::is_constructible_v<T, const optional<U>&&> ||
+            std::is_convertible_v<optional<U>&, T> ||
+            std::is_convertible_v<const optional<U>&, T> ||
+            std::is_convertible_v<optional<U>&&, T> ||
+            std::is_convertible_v<const optional<U>&&, T>;
+
+        template <class T, class U>
+        inline constexpr bool assigns_from_optional =
+            std::is_assignable_v<T&, optional<U>&> ||
+            std::is_assignable_v<T&, const optional<U>&> ||
+            std::is_assignable_v<T&, optional<U>&&> ||
+            std::is_assignable_v<T&, const optional<U>&&>;
+
+        template <class T, class U>
+        inline constexpr bool constructs_from_value =
+            std::is_constructible_v<T, U&&> &&
+            !std::is_same_v<remove_cvref_t<U>, std::in_place_t> &&
+            !std::is_same_v<remove_cvref_t<U>, in_place_invoke_t> &&
+            !std::is_same_v<remove_cvref_t<U>, optional<T>>;
+
+        template <class T, class U>
+        inline constexpr bool assigns_from_value =
+            !std::is_same_v<remove_cvref_t<U>, optional<T>> &&
+            !(std::is_scalar_v<T> && std::is_same_v<T, std::decay_t<U>>) &&
+            std::is_constructible_v<T, U> &&
+            std::is_assignable_v<T&, U>;
+
+        template <class T, class U, class Other>
+        inline constexpr bool constructs_from_optional =
+            !std::is_same_v<T, U> &&
+            std::is_constructible_v<T, Other> &&
+            !converts_from_optional<T, U>;
+
+        template <class T, class U, class Other>
+        inline constexpr bool assigns_from_optional_of =
+            !std::is_same_v<T, U> &&
+            std::is_constructible_v<T, Other> &&
+            std::is_assignable_v<T&, Other> &&
+            !converts_from_optional<T, U> &&
+            !assigns_from_optional<T, U>;
+    }
+
     template <class T>
     class optional {
     public:
-        //The most necessary constructors for the example
-        optional() noexcept = default;
+        //Constructors, assignment and emplace, following std::optional
+        constexpr optional() noexcept = default;
+        constexpr optional(std::nullopt_t) noexcept { }
+        //The copy and move operations are defaulted on top of storage_t<T>, so optional<T> is
+        //trivially copyable, movable and destructible exactly when T is, and can be memcpy'd
         optional(const optional<T>& rhs) = default;
+#ifdef KNATTEN_OPTIONAL_CONDITIONAL_NOEXCEPT
+        //Follows the storage rather than T, as moving a boxed T only moves the pointer
+        optional(optional<T>&& rhs) noexcept(std::is_nothrow_move_constructible_v<detail::storage_t<T>>) = default;
+#else
         optional(optional<T>&& rhs) noexcept = default;
-        optional(T val) : o_(std::move(val)) { }
+#endif
+
+        template <class... Args, std::enable_if_t<std::is_constructible_v<T, Args&&...>, int> = 0>
+        constexpr explicit optional(std::in_place_t, Args&&... args)
+            : o_(std::in_place, std::forward<Args>(args)...) { }
+
+        template <class U, class... Args,
+                  std::enable_if_t<std::is_constructible_v<T, std::initializer_list<U>&, Args&&...>, int> = 0>
+        constexpr explicit optional(std::in_place_t, std::initializer_list<U> il, Args&&... args)
+            : o_(std::in_place, il, std::forward<Args>(args)...) { }
+
+        template <class U = T, std::enable_if_t<
+            detail::constructs_from_value<T, U> && std::is_convertible_v<U&&, T>, int> = 0>
+        constexpr optional(U&& val)
+            : o_(std::in_place, std::forward<U>(val)) { }
+
+        template <class U = T, std::enable_if_t<
+            detail::constructs_from_value<T, U> && !std::is_convertible_v<U&&, T>, int> = 0>
+        constexpr explicit optional(U&& val)
+            : o_(std::in_place, std::forward<U>(val)) { }
+
+        template <class U, std::enable_if_t<
+            detail::constructs_from_optional<T, U, const U&> && std::is_convertible_v<const U&, T>, int> = 0>
+        optional(const optional<U>& rhs)
+            : o_(storage_from(rhs)) { }
+
+        template <class U, std::enable_if_t<
+            detail::constructs_from_optional<T, U, const U&> && !std::is_convertible_v<const U&, T>, int> = 0>
+        explicit optional(const optional<U>& rhs)
+            : o_(storage_from(rhs)) { }
+
+        template <class U, std::enable_if_t<
+            detail::constructs_from_optional<T, U, U&&> && std::is_convertible_v<U&&, T>, int> = 0>
+        optional(optional<U>&& rhs)
+            : o_(storage_from(std::move(rhs))) { }
+
+        template <class U, std::enable_if_t<
+            detail::constructs_from_optional<T, U, U&&> && !std::is_convertible_v<U&&, T>, int> = 0>
+        explicit optional(optional<U>&& rhs)
+            : o_(storage_from(std::move(rhs))) { }
+
+        optional& operator=(const optional<T>& rhs) = default;
+        optional& operator=(optional<T>&& rhs) = default;
+
+        optional& operator=(std::nullopt_t) noexcept {
+            reset();
+            return *this;
+        }
+
+        template <class U = T, std::enable_if_t<detail::assigns_from_value<T, U>, int> = 0>
+        optional& operator=(U&& val) {
+            if (has_value()) {
+                *o_ = std::forward<U>(val);
+            } else {
+                o_.emplace(std::forward<U>(val));
+            }
+            return *this;
+        }
+
+        template <class U, std::enable_if_t<detail::assigns_from_optional_of<T, U, const U&>, int> = 0>
+        optional& operator=(const optional<U>& rhs) {
+            if (!rhs.has_value()) {
+                reset();
+            } else if (has_value()) {
+                *o_ = *rhs;
+            } else {
+                o_.emplace(*rhs);
+            }
+            return *this;
+        }
+
+        template <class U, std::enable_if_t<detail::assigns_from_optional_of<T, U, U&&>, int> = 0>
+        optional& operator=(optional<U>&& rhs) {
+            if (!rhs.has_value()) {
+                reset();
+            } else if (has_value()) {
+                *o_ = *std::move(rhs);
+            } else {
+                o_.emplace(*std::move(rhs));
+            }
+            return *this;
+        }
+
+        //Destroys any current value and constructs a new one in place from args
+        template <class... Args>
+        T& emplace(Args&&... args) {
+            return o_.emplace(std::forward<Args>(args)...);
+        }
+
+        template <class U, class... Args>
+        T& emplace(std::initializer_list<U> il, Args&&... args) {
+            return o_.emplace(il, std::forward<Args>(args)...);
+        }
+
+        void reset() noexcept { o_.reset(); }
+
+        //Constructs the value directly from the prvalue returned by f(args...), so even a
+        //large or immovable result is constructed exactly once. Used by transform.
+        template <class F, class... Args>
+        constexpr explicit optional(in_place_invoke_t, F&& f, Args&&... args)
+            : o_(make_storage<F>(f, std::forward<Args>(args)...)) { }
 
         //Demonstration of the proposed methods
+        //
+        //With C++23 explicit object parameters each function is a single template deducing the
+        //value category of *this, otherwise it is the four &, const&, && and const&& overloads
+        //from the proposal. Both forward to the same implementation below.
+#ifdef KNATTEN_OPTIONAL_DEDUCING_THIS
+        template <class Self, class UnaryOperation>
+        constexpr decltype(auto) transform(this Self&& self, UnaryOperation&& op)
+            KNATTEN_OPTIONAL_NOEXCEPT_IF(detail::is_nothrow_transform<UnaryOperation, value_t<Self>>) {
+            return transform_impl(std::forward<Self>(self), std::forward<UnaryOperation>(op));
+        }
 
+        template <class Self, class UnaryOperation>
+        constexpr decltype(auto) transform_optional(this Self&& self, UnaryOperation&& op)
+            KNATTEN_OPTIONAL_NOEXCEPT_IF(std::is_nothrow_invocable_v<UnaryOperation, value_t<Self>>) {
+            return transform_optional_impl(std::forward<Self>(self), std::forward<UnaryOperation>(op));
+        }
+
+        template <class Self, class UnaryOperation>
+        constexpr void call(this Self&& self, UnaryOperation&& op)
+            KNATTEN_OPTIONAL_NOEXCEPT_IF(std::is_nothrow_invocable_v<UnaryOperation, value_t<Self>>) {
+            call_impl(std::forward<Self>(self), std::forward<UnaryOperation>(op));
+        }
+#else
         template <class UnaryOperation>
-        constexpr decltype(auto) transform(UnaryOperation op) & {
-            using OptionalReturnType = optional<decltype(op(*o_))>;
-            return has_value() ?
-                OptionalReturnType(op(*o_)) :
-                OptionalReturnType();
+        constexpr decltype(auto) transform(UnaryOperation&& op) &
+            KNATTEN_OPTIONAL_NOEXCEPT_IF(detail::is_nothrow_transform<UnaryOperation, T&>) {
+            return transform_impl(*this, std::forward<UnaryOperation>(op));
         }
 
         template <class UnaryOperation>
-        constexpr decltype(auto) transform(UnaryOperation op) const& {
-            using OptionalReturnType = optional<decltype(op(*o_))>;
-            return has_value() ?
-                OptionalReturnType(op(*o_)) :
-                OptionalReturnType();
+        constexpr decltype(auto) transform(UnaryOperation&& op) const&
+            KNATTEN_OPTIONAL_NOEXCEPT_IF(detail::is_nothrow_transform<UnaryOperation, const T&>) {
+            return transform_impl(*this, std::forward<UnaryOperation>(op));
         }
 
         template <class UnaryOperation>
-        constexpr decltype(auto) transform(UnaryOperation op) &&{
-            using OptionalReturnType = optional<decltype(op(std::move(*o_)))>;
-            return has_value() ?
-                OptionalReturnType(op(std::move(*o_))) :
-                OptionalReturnType();
+        constexpr decltype(auto) transform(UnaryOperation&& op) &&
+            KNATTEN_OPTIONAL_NOEXCEPT_IF(detail::is_nothrow_transform<UnaryOperation, T&&>) {
+            return transform_impl(std::move(*this), std::forward<UnaryOperation>(op));
         }
 
         template <class UnaryOperation>
-        constexpr decltype(auto) transform(UnaryOperation op) const&&{
-            using OptionalReturnType = optional<decltype(op(std::move(*o_)))>;
-            return has_value() ?
-                OptionalReturnType(op(std::move(*o_))) :
-                OptionalReturnType();
+        constexpr decltype(auto) transform(UnaryOperation&& op) const&&
+            KNATTEN_OPTIONAL_NOEXCEPT_IF(detail::is_nothrow_transform<UnaryOperation, const T&&>) {
+            return transform_impl(std::move(*this), std::forward<UnaryOperation>(op));
         }
 
         template <class UnaryOperation>
-        constexpr decltype(auto) transform_optional(UnaryOperation op) & {
-            using OptionalReturnType = decltype(op(*o_));
-            return has_value() ?
-                op(*o_) :
-                OptionalReturnType();
+        constexpr decltype(auto) transform_optional(UnaryOperation&& op) &
+            KNATTEN_OPTIONAL_NOEXCEPT_IF(std::is_nothrow_invocable_v<UnaryOperation, T&>) {
+            return transform_optional_impl(*this, std::forward<UnaryOperation>(op));
         }
 
         template <class UnaryOperation>
-        constexpr decltype(auto) transform_optional(UnaryOperation op) const& {
-            using OptionalReturnType = decltype(op(*o_));
-            return has_value() ?
-                op(*o_) :
-                OptionalReturnType();
+        constexpr decltype(auto) transform_optional(UnaryOperation&& op) const&
+            KNATTEN_OPTIONAL_NOEXCEPT_IF(std::is_nothrow_invocable_v<UnaryOperation, const T&>) {
+            return transform_optional_impl(*this, std::forward<UnaryOperation>(op));
         }
 
         template <class UnaryOperation>
-        constexpr decltype(auto) transform_optional(UnaryOperation op) && {
-            using OptionalReturnType = decltype(op(std::move(*o_)));
-            return has_value() ?
-                op(std::move(*o_)) :
-                OptionalReturnType();
+        constexpr decltype(auto) transform_optional(UnaryOperation&& op) &&
+            KNATTEN_OPTIONAL_NOEXCEPT_IF(std::is_nothrow_invocable_v<UnaryOperation, T&&>) {
+            return transform_optional_impl(std::move(*this), std::forward<UnaryOperation>(op));
         }
 
         template <class UnaryOperation>
-        constexpr decltype(auto) transform_optional(UnaryOperation op) const&& {
-            using OptionalReturnType = decltype(op(std::move(*o_)));
-            return has_value() ?
-                op(std::move(*o_)) :
-                OptionalReturnType();
+        constexpr decltype(auto) transform_optional(UnaryOperation&& op) const&&
+            KNATTEN_OPTIONAL_NOEXCEPT_IF(std::is_nothrow_invocable_v<UnaryOperation, const T&&>) {
+            return transform_optional_impl(std::move(*this), std::forward<UnaryOperation>(op));
         }
 
         template <class UnaryOperation>
-        constexpr void call(UnaryOperation op) & {
-            if (has_value()) {
-                op(*o_);
-            }
+        constexpr void call(UnaryOperation&& op) &
+            KNATTEN_OPTIONAL_NOEXCEPT_IF(std::is_nothrow_invocable_v<UnaryOperation, T&>) {
+            call_impl(*this, std::forward<UnaryOperation>(op));
         }
 
         template <class UnaryOperation>
-        constexpr void call(UnaryOperation op) const& {
-            if (has_value()) {
-                op(*o_);
-            }
+        constexpr void call(UnaryOperation&& op) const&
+            KNATTEN_OPTIONAL_NOEXCEPT_IF(std::is_nothrow_invocable_v<UnaryOperation, const T&>) {
+            call_impl(*this, std::forward<UnaryOperation>(op));
         }
 
         template <class UnaryOperation>
-        constexpr void call(UnaryOperation op) && {
-            if (has_value()) {
-                op(std::move(*o_));
-            }
+        constexpr void call(UnaryOperation&& op) &&
+            KNATTEN_OPTIONAL_NOEXCEPT_IF(std::is_nothrow_invocable_v<UnaryOperation, T&&>) {
+            call_impl(std::move(*this), std::forward<UnaryOperation>(op));
         }
 
         template <class UnaryOperation>
-        constexpr void call(UnaryOperation op) const&& {
-            if (has_value()) {
-                op(std::move(*o_));
-            }
+        constexpr void call(UnaryOperation&& op) const&&
+            KNATTEN_OPTIONAL_NOEXCEPT_IF(std::is_nothrow_invocable_v<UnaryOperation, const T&&>) {
+            call_impl(std::move(*this), std::forward<UnaryOperation>(op));
+        }
+#endif
+
+        //transform for an op from T to T, reusing this optional's value instead of constructing a
+        //new optional. If op returns a T, it is called with the value as an rvalue and the result is
+        //move assigned back, so e.g. a string that op appends to keeps its buffer all the way. If op
+        //returns void, it is called with the value as an lvalue to modify it. An op taking a T& and
+        //returning a value does not compile, as the value would be lost. Returns *this, moved from
+        //if it is an rvalue:
+        //    auto name = find_first("foo").transform_in_place(to_upper);
+        template <class UnaryOperation>
+        constexpr optional& transform_in_place(UnaryOperation&& op) &
+            KNATTEN_OPTIONAL_NOEXCEPT_IF(detail::is_nothrow_transform_in_place<UnaryOperation, T>()) {
+            transform_in_place_impl(std::forward<UnaryOperation>(op));
+            return *this;
+        }
+
+        template <class UnaryOperation>
+        constexpr optional transform_in_place(UnaryOperation&& op) &&
+            KNATTEN_OPTIONAL_NOEXCEPT_IF(detail::is_nothrow_transform_in_place<UnaryOperation, T>() &&
+                                         std::is_nothrow_move_constructible_v<T>) {
+            transform_in_place_impl(std::forward<UnaryOperation>(op));
+            return std::move(*this);
         }
 
         // Forward observers
@@ -123,7 +698,177 @@ namespace knatten {
         constexpr T* operator->() { return o_.operator->(); }
 
     private:
-        std::optional<T> o_;
+        template <class U>
+        friend class optional;
+
+        //The value as seen through a Self, i.e. T&, const T&, T&& or const T&&
+        template <class Self>
+        using value_t = decltype(*std::declval<Self>().o_);
+
+        //*std::forward<Self>(self).o_ is the value as T&, const T&, T&& or const T&&, matching self.
+        //op is taken by forwarding reference and called like std::invoke does, so functors are never
+        //copied and member pointers work too. A reference result, e.g. from a pointer to data
+        //member, is copied into the resulting optional.
+        template <class Self, class UnaryOperation>
+        static constexpr decltype(auto) transform_impl(Self&& self, UnaryOperation&& op) {
+            using ValueType = detail::remove_cvref_t<
+                detail::invoke_result_t<UnaryOperation, decltype(*std::forward<Self>(self).o_)>>;
+            using OptionalReturnType = optional<ValueType>;
+            if constexpr (detail::is_boxed<T> && !std::is_lvalue_reference_v<Self> && !std::is_const_v<std::remove_reference_t<Self>>) {
+                if (!self.has_value()) {
+                    return OptionalReturnType();
+                }
+                OptionalReturnType result(in_place_invoke, std::forward<UnaryOperation>(op), *std::forward<Self>(self).o_);
+                self.o_.reset();
+                return result;
+            } else {
+                return self.has_value() ?
+                    OptionalReturnType(in_place_invoke, std::forward<UnaryOperation>(op), *std::forward<Self>(self).o_) :
+                    OptionalReturnType();
+            }
+        }
+
+        template <class Self, class UnaryOperation>
+        static constexpr decltype(auto) transform_optional_impl(Self&& self, UnaryOperation&& op) {
+            using OptionalReturnType = detail::invoke_result_t<UnaryOperation, decltype(*std::forward<Self>(self).o_)>;
+            return self.has_value() ?
+                detail::invoke(std::forward<UnaryOperation>(op), *std::forward<Self>(self).o_) :
+                OptionalReturnType();
+        }
+
+        template <class Self, class UnaryOperation>
+        static constexpr void call_impl(Self&& self, UnaryOperation&& op) {
+            if (self.has_value()) {
+                detail::invoke(std::forward<UnaryOperation>(op), *std::forward<Self>(self).o_);
+            }
+        }
+
+        template <class UnaryOperation>
+        constexpr void transform_in_place_impl(UnaryOperation&& op) {
+            if (!has_value()) {
+                return;
+            }
+            if constexpr (detail::returns_replacement<UnaryOperation, T>::value) {
+                *o_ = detail::invoke(std::forward<UnaryOperation>(op), std::move(*o_));
+            } else {
+                static_assert(std::is_void_v<detail::invoke_result_t<UnaryOperation, T&>>,
+                              "transform_in_place: an op taking T& must modify it and return void, "
+                              "take the value by value or as T&& to return a replacement");
+                detail::invoke(std::forward<UnaryOperation>(op), *o_);
+            }
+        }
+
+        //Storage holding the value of rhs, if any, converted to T
+        template <class Optional>
+        static constexpr detail::storage_t<T> storage_from(Optional&& rhs) {
+            return rhs.has_value() ?
+                detail::storage_t<T>(std::in_place, *std::forward<Optional>(rhs)) :
+                detail::storage_t<T>();
+        }
+
+        template <class F, class... Args>
+        static constexpr detail::storage_t<T> make_storage(F& f, Args&&... args) {
+            if constexpr (detail::is_constructible_from_anything<T>) {
+                return detail::storage_t<T>(detail::invoke(std::forward<F>(f), std::forward<Args>(args)...));
+            } else {
+                return detail::storage_t<T>(std::in_place,
+                    detail::invoke_result_converter<F, Args...>{f, std::forward_as_tuple(std::forward<Args>(args)...)});
+            }
+        }
+
+        detail::storage_t<T> o_{};
+    };
+
+    //optional<T&>, a possibly empty reference to a T stored elsewhere, so that e.g. a lookup in a
+    //cache can report what it found without copying it:
+    //    optional<const tweet&> find_first(const string& search_string);
+    //It is a single pointer, trivially copyable, and assigning to it rebinds it rather than
+    //assigning through it. It only binds to lvalues, including the value of an lvalue optional<U>.
+    //transform, transform_optional and call pass op the referenced T& whatever the value category
+    //of the optional<T&> itself, and transform returns an optional of the result by value.
+    template <class T>
+    class optional<T&> {
+        template <class U>
+        static constexpr bool binds = std::is_convertible_v<std::remove_reference_t<U>*, T*>;
+
+    public:
+        constexpr optional() noexcept = default;
+        constexpr optional(std::nullopt_t) noexcept { }
+        optional(const optional& rhs) = default;
+
+        template <class U, std::enable_if_t<std::is_lvalue_reference_v<U> &&
+            !detail::is_optional<detail::remove_cvref_t<U>>::value && binds<U>, int> = 0>
+        constexpr optional(U&& ref) noexcept : p_(std::addressof(ref)) { }
+
+        template <class U, std::enable_if_t<binds<U>, int> = 0>
+        constexpr optional(optional<U>& rhs) noexcept : p_(rhs.has_value() ? std::addressof(*rhs) : nullptr) { }
+
+        template <class U, std::enable_if_t<binds<const U>, int> = 0>
+        constexpr optional(const optional<U>& rhs) noexcept : p_(rhs.has_value() ? std::addressof(*rhs) : nullptr) { }
+
+        //Would refer into a temporary, unless U is itself a reference
+        template <class U, std::enable_if_t<!std::is_reference_v<U>, int> = 0>
+        optional(const optional<U>&& rhs) = delete;
+
+        optional& operator=(const optional& rhs) = default;
+
+        optional& operator=(std::nullopt_t) noexcept {
+            reset();
+            return *this;
+        }
+
+        //Rebinds to ref
+        template <class U, std::enable_if_t<std::is_lvalue_reference_v<U> && binds<U>, int> = 0>
+        T& emplace(U&& ref) noexcept {
+            p_ = std::addressof(ref);
+            return *p_;
+        }
+
+        void reset() noexcept { p_ = nullptr; }
+
+        template <class UnaryOperation>
+        constexpr auto transform(UnaryOperation&& op) const
+            KNATTEN_OPTIONAL_NOEXCEPT_IF(detail::is_nothrow_transform<UnaryOperation, T&>) {
+            using OptionalReturnType = optional<detail::remove_cvref_t<detail::invoke_result_t<UnaryOperation, T&>>>;
+            return has_value() ?
+                OptionalReturnType(in_place_invoke, std::forward<UnaryOperation>(op), *p_) :
+                OptionalReturnType();
+        }
+
+        template <class UnaryOperation>
+        constexpr auto transform_optional(UnaryOperation&& op) const
+            KNATTEN_OPTIONAL_NOEXCEPT_IF(std::is_nothrow_invocable_v<UnaryOperation, T&>) {
+            using OptionalReturnType = detail::invoke_result_t<UnaryOperation, T&>;
+            return has_value() ?
+                detail::invoke(std::forward<UnaryOperation>(op), *p_) :
+                OptionalReturnType();
+        }
+
+        template <class UnaryOperation>
+        constexpr void call(UnaryOperation&& op) const
+            KNATTEN_OPTIONAL_NOEXCEPT_IF(std::is_nothrow_invocable_v<UnaryOperation, T&>) {
+            if (has_value()) {
+                detail::invoke(std::forward<UnaryOperation>(op), *p_);
+            }
+        }
+
+        constexpr bool has_value() const noexcept { return p_ != nullptr; }
+
+        constexpr T& value() const {
+            if (!has_value()) {
+                throw std::bad_optional_access();
+            }
+            return *p_;
+        }
+
+        constexpr T& operator*() const { return *p_; }
+        constexpr T* operator->() const { return p_; }
+
+    private:
+        T* p_ = nullptr;
     };
+
+    template <class T>
+    optional(T) -> optional<T>;
 }
 #endif
@@ -1,5 +1,12 @@
 #include "optional_ext.h"
 #include "catch.hpp"
+#include "probe.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <vector>
 
 using std::string;
 using knatten::optional;
@@ -212,3 +219,774 @@ TEST_CASE("call") {
         REQUIRE(called4 == false);
     }
 }
+
+//niche_traits is only specialised for types owned by this file, a specialisation for e.g. float
+//would change optional<float> here but not in the other files using it
+namespace {
+    struct node { int id; };
+    enum class color : unsigned char { red, green, blue };
+    enum class user_id : std::uint32_t { };
+    struct reading { float v; };
+}
+
+template <> struct knatten::niche_traits<node*> : knatten::null_pointer_niche<node*> { };
+template <> struct knatten::niche_traits<color> : knatten::sentinel_niche<color, color(0xff)> { };
+template <> struct knatten::niche_traits<user_id> : knatten::sentinel_niche<user_id, user_id(0xffffffff)> { };
+
+template <> struct knatten::niche_traits<reading> {
+    static constexpr bool enabled = true;
+    static reading empty_value() noexcept { return reading{nan_niche<float>::empty_value()}; }
+    static bool is_empty(const reading& r) noexcept { return nan_niche<float>::is_empty(r.v); }
+};
+
+TEST_CASE("niche storage") {
+    SECTION("is the size of T") {
+        static_assert(sizeof(optional<node*>) == sizeof(node*));
+        static_assert(sizeof(optional<color>) == sizeof(color));
+        static_assert(sizeof(optional<user_id>) == sizeof(user_id));
+        static_assert(sizeof(optional<reading>) == sizeof(reading));
+        static_assert(sizeof(optional<int>) > sizeof(int));
+    }
+
+    SECTION("with null pointer niche") {
+        node n{42};
+        optional<node*> o(&n);
+        REQUIRE(o.has_value() == true);
+        REQUIRE(o.transform([](node* p){ return p->id; }).value() == 42);
+        REQUIRE(optional<node*>().has_value() == false);
+    }
+
+    SECTION("with sentinel niche") {
+        optional<color> c(color::blue);
+        REQUIRE(*c == color::blue);
+        REQUIRE(optional<color>().has_value() == false);
+
+        auto next = optional(user_id(7)).transform([](user_id id){ return user_id(static_cast<std::uint32_t>(id) + 1); });
+        REQUIRE(next.value() == user_id(8));
+        REQUIRE(optional<user_id>(user_id(0xffffffff)).has_value() == false);
+    }
+
+    SECTION("with NaN niche") {
+        optional<reading> r(reading{std::numeric_limits<float>::quiet_NaN()});
+        REQUIRE(r.has_value() == true);
+        auto doubled = [](reading v){ return reading{v.v*2}; };
+        REQUIRE(optional<reading>(reading{1.5f}).transform(doubled).value().v == 3.0f);
+
+        optional<reading> empty;
+        REQUIRE(empty.has_value() == false);
+        REQUIRE_THROWS_AS(empty.value(), std::bad_optional_access);
+        REQUIRE(empty.transform(doubled).has_value() == false);
+    }
+}
+
+namespace {
+    struct immovable {
+        explicit immovable(int v) : value(v) { }
+        immovable(const immovable&) = delete;
+        immovable(immovable&&) = delete;
+        int value;
+    };
+}
+
+TEST_CASE("transform constructs the result in place") {
+    SECTION("with lvalue") {
+        optional o(2);
+        auto p = o.transform([](int v){ return immovable(v*2);});
+        REQUIRE(p->value == 4);
+    }
+
+    SECTION("with rvalue") {
+        auto p = optional(3).transform([](int&& v){ return immovable(v*2);});
+        REQUIRE(p->value == 6);
+    }
+
+    SECTION("with no value") {
+        auto p = optional<int>().transform([](int v){ return immovable(v);});
+        REQUIRE(p.has_value() == false);
+    }
+
+    SECTION("with in_place_invoke") {
+        optional<immovable> p(knatten::in_place_invoke, [](int a, int b){ return immovable(a + b);}, 1, 2);
+        REQUIRE(p->value == 3);
+    }
+}
+
+namespace {
+    struct heavy {
+        heavy(int a, int b) : sum(a + b) { }
+        heavy(std::initializer_list<int> il, int c) : sum(c) { for (int i : il) sum += i; }
+        heavy(const heavy&) = delete;
+        heavy(heavy&&) = delete;
+        int sum;
+    };
+
+    struct explicit_from_int {
+        explicit explicit_from_int(int v) : value(v) { }
+        int value;
+    };
+}
+
+TEST_CASE("constructors") {
+    SECTION("with nullopt") {
+        optional<int> o(std::nullopt);
+        REQUIRE(o.has_value() == false);
+    }
+
+    SECTION("with in_place") {
+        optional<heavy> o(std::in_place, 1, 2);
+        REQUIRE(o->sum == 3);
+
+        optional<heavy> o2(std::in_place, {1, 2, 3}, 4);
+        REQUIRE(o2->sum == 10);
+    }
+
+    SECTION("converting from value") {
+        optional<string> o = "foo";
+        REQUIRE(o.value() == "foo");
+
+        optional<explicit_from_int> e(3);
+        REQUIRE(e->value == 3);
+        static_assert(!std::is_convertible_v<int, optional<explicit_from_int>>);
+    }
+
+    SECTION("converting from optional") {
+        optional<const char*> c("foo");
+        optional<string> s = c;
+        REQUIRE(s.value() == "foo");
+
+        optional<string> s2 = optional<const char*>("bar");
+        REQUIRE(s2.value() == "bar");
+
+        optional<string> s3 = optional<const char*>();
+        REQUIRE(s3.has_value() == false);
+
+        optional<explicit_from_int> e(optional<int>(4));
+        REQUIRE(e->value == 4);
+        static_assert(!std::is_convertible_v<optional<int>, optional<explicit_from_int>>);
+    }
+}
+
+TEST_CASE("assignment") {
+    SECTION("with nullopt") {
+        optional o(2);
+        o = std::nullopt;
+        REQUIRE(o.has_value() == false);
+    }
+
+    SECTION("with braces") {
+        optional o(2);
+        o = {};
+        REQUIRE(o.has_value() == false);
+    }
+
+    SECTION("with value") {
+        optional<string> o;
+        o = "foo";
+        REQUIRE(o.value() == "foo");
+        o = string("bar");
+        REQUIRE(o.value() == "bar");
+    }
+
+    SECTION("with optional of other type") {
+        optional<string> o;
+        o = optional<const char*>("foo");
+        REQUIRE(o.value() == "foo");
+
+        const optional<const char*> c("bar");
+        o = c;
+        REQUIRE(o.value() == "bar");
+
+        o = optional<const char*>();
+        REQUIRE(o.has_value() == false);
+    }
+}
+
+TEST_CASE("emplace and reset") {
+    SECTION("emplace") {
+        optional<heavy> o;
+        heavy& h = o.emplace(1, 2);
+        REQUIRE(h.sum == 3);
+        REQUIRE(&h == &*o);
+
+        o.emplace({1, 2}, 3);
+        REQUIRE(o->sum == 6);
+    }
+
+    SECTION("reset") {
+        optional<heavy> o(std::in_place, 1, 2);
+        o.reset();
+        REQUIRE(o.has_value() == false);
+    }
+
+    SECTION("with niche storage") {
+        optional<color> c;
+        c.emplace(color::green);
+        REQUIRE(*c == color::green);
+        c = color::red;
+        REQUIRE(*c == color::red);
+        c.reset();
+        REQUIRE(c.has_value() == false);
+    }
+}
+
+namespace {
+    //Checks the probe counts since the last probe::reset(), assignments are never expected
+    void require_counts(int constructions, int copies, int moves, int destructions) {
+        const auto& c = probe::count();
+        REQUIRE(c.constructions == constructions);
+        REQUIRE(c.copies == copies);
+        REQUIRE(c.moves == moves);
+        REQUIRE(c.copy_assignments == 0);
+        REQUIRE(c.move_assignments == 0);
+        REQUIRE(c.destructions == destructions);
+    }
+}
+
+TEST_CASE("transform copies and moves") {
+    SECTION("with lvalue") {
+        optional<probe> o(std::in_place, 1);
+        probe::reset();
+        {
+            auto p = o.transform([](probe& v){ return probe(v.value);});
+            REQUIRE(p->value == 1);
+        }
+        require_counts(1, 0, 0, 1);
+
+        probe::reset();
+        o.transform([](const probe& v){ return v;});
+        require_counts(0, 1, 0, 1);
+    }
+
+    SECTION("with const lvalue") {
+        const optional<probe> o(std::in_place, 1);
+        probe::reset();
+        o.transform([](const probe& v){ return probe(v.value);});
+        require_counts(1, 0, 0, 1);
+
+        probe::reset();
+        o.transform([](const probe& v){ return v;});
+        require_counts(0, 1, 0, 1);
+    }
+
+    SECTION("with rvalue") {
+        optional<probe> o(std::in_place, 1);
+        probe::reset();
+        {
+            auto p = std::move(o).transform([](probe&& v){ return std::move(v);});
+            REQUIRE(p->value == 1);
+        }
+        require_counts(0, 0, 1, 1);
+    }
+
+    SECTION("with const rvalue") {
+        const optional<probe> o(std::in_place, 1);
+        probe::reset();
+        std::move(o).transform([](const probe&& v){ return v;});
+        require_counts(0, 1, 0, 1);
+    }
+
+    SECTION("with no value") {
+        optional<probe> o;
+        probe::reset();
+        o.transform([](probe& v){ return v;});
+        std::as_const(o).transform([](const probe& v){ return v;});
+        std::move(o).transform([](probe&& v){ return std::move(v);});
+        std::move(std::as_const(o)).transform([](const probe&& v){ return v;});
+        require_counts(0, 0, 0, 0);
+    }
+}
+
+TEST_CASE("converting constructors construct the value once") {
+    optional<int> i(1);
+    probe::reset();
+    optional<probe> from_lvalue(i);
+    optional<probe> from_rvalue(std::move(i));
+    optional<probe> from_empty{optional<int>()};
+    require_counts(2, 0, 0, 0);
+    REQUIRE(from_rvalue->value == 1);
+    REQUIRE(from_empty.has_value() == false);
+}
+
+TEST_CASE("transform_optional copies and moves") {
+    SECTION("with lvalue") {
+        optional<probe> o(std::in_place, 1);
+        probe::reset();
+        o.transform_optional([](probe& v){ return optional<probe>(std::in_place, v.value);});
+        require_counts(1, 0, 0, 1);
+    }
+
+    SECTION("with const lvalue") {
+        const optional<probe> o(std::in_place, 1);
+        probe::reset();
+        o.transform_optional([](const probe& v){ return optional<probe>(v);});
+        require_counts(0, 1, 0, 1);
+    }
+
+    SECTION("with rvalue") {
+        optional<probe> o(std::in_place, 1);
+        probe::reset();
+        std::move(o).transform_optional([](probe&& v){ return optional<probe>(std::move(v));});
+        require_counts(0, 0, 1, 1);
+    }
+
+    SECTION("with const rvalue") {
+        const optional<probe> o(std::in_place, 1);
+        probe::reset();
+        std::move(o).transform_optional([](const probe&& v){ return optional<probe>(v);});
+        require_counts(0, 1, 0, 1);
+    }
+
+    SECTION("with no value") {
+        optional<probe> o;
+        probe::reset();
+        o.transform_optional([](probe& v){ return optional<probe>(v);});
+        std::move(o).transform_optional([](probe&& v){ return optional<probe>(std::move(v));});
+        require_counts(0, 0, 0, 0);
+    }
+}
+
+TEST_CASE("call copies and moves") {
+    optional<probe> o(std::in_place, 1);
+    probe::reset();
+    o.call([](probe&){});
+    std::as_const(o).call([](const probe&){});
+    std::move(o).call([](probe&&){});
+    std::move(std::as_const(o)).call([](const probe&&){});
+    require_counts(0, 0, 0, 0);
+
+    probe::reset();
+    std::move(o).call([](probe&& v){ probe taken(std::move(v));});
+    require_counts(0, 0, 1, 1);
+}
+
+TEST_CASE("transform_in_place") {
+    SECTION("op returning T") {
+        optional<string> o("foo");
+        REQUIRE(&o.transform_in_place([](string&& s){ return s + "bar";}) == &o);
+        REQUIRE(o.value() == "foobar");
+    }
+
+    SECTION("op modifying T") {
+        optional<string> o("foo");
+        o.transform_in_place([](string& s){ s += "bar";}).transform_in_place([](string& s){ s += "baz";});
+        REQUIRE(o.value() == "foobarbaz");
+    }
+
+    SECTION("with rvalue") {
+        auto o = optional<string>("foo").transform_in_place([](string&& s){ return std::move(s) + "bar";});
+        REQUIRE(o.value() == "foobar");
+    }
+
+    SECTION("with no value") {
+        optional<string> o;
+        o.transform_in_place([](string& s){ s += "bar";});
+        REQUIRE(o.has_value() == false);
+        REQUIRE(optional<string>().transform_in_place([](string&& s){ return s;}).has_value() == false);
+    }
+
+    SECTION("reuses the buffer") {
+        optional<string> o(std::in_place, 64, 'x');
+        o->reserve(128);
+        const char* buffer = o->data();
+        o.transform_in_place([](string&& s){ s.append(8, 'y'); return std::move(s);});
+        REQUIRE(o->data() == buffer);
+        auto moved = std::move(o).transform_in_place([](string& s){ s.append(8, 'z');});
+        REQUIRE(moved->data() == buffer);
+        REQUIRE(moved->size() == 80);
+    }
+
+    SECTION("copies and moves") {
+        optional<probe> o(std::in_place, 1);
+        probe::reset();
+        o.transform_in_place([](probe& v){ ++v.value;});
+        require_counts(0, 0, 0, 0);
+        REQUIRE(o->value == 2);
+
+        //The result is move assigned back rather than destroying the value and constructing a new one
+        probe::reset();
+        o.transform_in_place([](probe&& v){ ++v.value; return std::move(v);});
+        REQUIRE(probe::count().move_assignments == 1);
+        REQUIRE(probe::count().moves == 1);
+        REQUIRE(probe::count().destructions == 1);
+        REQUIRE(o->value == 3);
+    }
+}
+
+namespace {
+    struct record {
+        string name;
+        std::size_t size() const { return name.size(); }
+        optional<string> nickname() const { return name.empty() ? optional<string>() : optional(name.substr(0, 1)); }
+    };
+
+    //A functor that counts how often it is copied
+    struct copy_counting_op {
+        copy_counting_op() = default;
+        copy_counting_op(const copy_counting_op& rhs) : copies(rhs.copies) { ++*copies; }
+        int operator()(int v) const { return v + 1; }
+        std::shared_ptr<int> copies = std::make_shared<int>(0);
+    };
+}
+
+TEST_CASE("member pointers") {
+    SECTION("to data member") {
+        optional<record> r(record{"foo"});
+        auto name = r.transform(&record::name);
+        REQUIRE(name.value() == "foo");
+
+        auto moved = std::move(r).transform(&record::name);
+        REQUIRE(moved.value() == "foo");
+    }
+
+    SECTION("to member function") {
+        const optional<record> r(record{"foo"});
+        REQUIRE(r.transform(&record::size).value() == 3);
+        REQUIRE(r.transform_optional(&record::nickname).value() == "f");
+        REQUIRE(optional<record>().transform(&record::size).has_value() == false);
+    }
+}
+
+TEST_CASE("functors are not copied") {
+    copy_counting_op op;
+    optional o(1);
+    o.transform(op);
+    std::as_const(o).transform(op);
+    optional(1).transform(op);
+    o.transform_optional([&op](int v){ return optional(op(v));});
+    o.call(op);
+    std::move(o).call(op);
+    REQUIRE(*op.copies == 0);
+}
+
+namespace {
+    struct throwing_move {
+        throwing_move() = default;
+        throwing_move(const throwing_move&) = default;
+        throwing_move(throwing_move&&) noexcept(false) { }
+    };
+}
+
+TEST_CASE("noexcept") {
+#ifdef KNATTEN_OPTIONAL_CONDITIONAL_NOEXCEPT
+    SECTION("move constructor follows T") {
+        static_assert(std::is_nothrow_move_constructible_v<optional<string>>);
+        static_assert(!std::is_nothrow_move_constructible_v<optional<throwing_move>>);
+    }
+#else
+    SECTION("move constructor is noexcept") {
+        static_assert(std::is_nothrow_move_constructible_v<optional<string>>);
+        static_assert(std::is_nothrow_move_constructible_v<optional<throwing_move>>);
+    }
+#endif
+
+    SECTION("vector growth moves") {
+        std::vector<optional<probe>> v;
+        v.emplace_back(std::in_place, 1);
+        probe::reset();
+        for (int i = 0; i < 100; ++i) {
+            v.emplace_back(std::in_place, i);
+        }
+        REQUIRE(probe::count().copies == 0);
+        REQUIRE(probe::count().moves > 0);
+    }
+
+    SECTION("transform, transform_optional, call and transform_in_place") {
+        optional o(1);
+        auto nothrow_op = [](int v) noexcept { return v; };
+        auto throwing_op = [](int v) { return v; };
+        auto nothrow_optional_op = [](int v) noexcept { return optional<int>(v); };
+#ifdef KNATTEN_OPTIONAL_CONDITIONAL_NOEXCEPT
+        static_assert(noexcept(o.transform(nothrow_op)));
+        static_assert(noexcept(std::as_const(o).transform(nothrow_op)));
+        static_assert(noexcept(std::move(o).transform(nothrow_op)));
+        static_assert(noexcept(std::move(std::as_const(o)).transform(nothrow_op)));
+        static_assert(noexcept(o.transform_optional(nothrow_optional_op)));
+        static_assert(noexcept(std::move(o).transform_optional(nothrow_optional_op)));
+        static_assert(noexcept(o.call(nothrow_op)));
+        static_assert(noexcept(std::move(o).call(nothrow_op)));
+        static_assert(noexcept(o.transform_in_place(nothrow_op)));
+        static_assert(noexcept(std::move(o).transform_in_place(nothrow_op)));
+        //A returned prvalue initialises the result in place, so a throwing move does not matter,
+        //but a returned reference is moved from, which may throw even if op does not
+        auto throwing_move_op = [](int) noexcept { return throwing_move(); };
+        static_assert(noexcept(o.transform(throwing_move_op)));
+        throwing_move moved_from;
+        auto throwing_move_reference_op = [&moved_from](int) noexcept -> throwing_move&& { return std::move(moved_from); };
+        static_assert(!noexcept(o.transform(throwing_move_reference_op)));
+#else
+        static_assert(!noexcept(o.transform(nothrow_op)));
+        static_assert(!noexcept(o.transform_optional(nothrow_optional_op)));
+        static_assert(!noexcept(o.call(nothrow_op)));
+        static_assert(!noexcept(o.transform_in_place(nothrow_op)));
+#endif
+        static_assert(!noexcept(o.transform(throwing_op)));
+        static_assert(!noexcept(o.transform_in_place(throwing_op)));
+        static_assert(!noexcept(o.call(throwing_op)));
+        REQUIRE(o.transform(nothrow_op).value() == 1);
+    }
+}
+
+namespace {
+    struct point { int x; int y; };
+
+    struct nontrivial_copy {
+        nontrivial_copy() = default;
+        nontrivial_copy(const nontrivial_copy&) { }
+    };
+
+    struct nontrivial_destructor {
+        ~nontrivial_destructor() { }
+    };
+
+    template <class T>
+    constexpr bool same_triviality =
+        std::is_trivially_copyable_v<optional<T>> == std::is_trivially_copyable_v<T> &&
+        std::is_trivially_copy_constructible_v<optional<T>> == std::is_trivially_copy_constructible_v<T> &&
+        std::is_trivially_move_constructible_v<optional<T>> == std::is_trivially_move_constructible_v<T> &&
+        std::is_trivially_destructible_v<optional<T>> == std::is_trivially_destructible_v<T>;
+}
+
+TEST_CASE("triviality") {
+    SECTION("follows T") {
+        static_assert(same_triviality<int>);
+        static_assert(same_triviality<double>);
+        static_assert(same_triviality<point>);
+        static_assert(same_triviality<node*>);
+        static_assert(same_triviality<color>);
+        static_assert(same_triviality<user_id>);
+        static_assert(same_triviality<float>);
+        static_assert(same_triviality<string>);
+        static_assert(same_triviality<std::unique_ptr<int>>);
+        static_assert(same_triviality<nontrivial_copy>);
+        static_assert(same_triviality<nontrivial_destructor>);
+        static_assert(same_triviality<probe>);
+    }
+
+    SECTION("trivially copyable") {
+        static_assert(std::is_trivially_copyable_v<optional<int>>);
+        static_assert(std::is_trivially_copyable_v<optional<point>>);
+        static_assert(std::is_trivially_copyable_v<optional<node*>>);
+        static_assert(!std::is_trivially_copyable_v<optional<string>>);
+        static_assert(!std::is_trivially_copyable_v<optional<nontrivial_copy>>);
+        static_assert(std::is_trivially_destructible_v<optional<nontrivial_copy>>);
+        static_assert(!std::is_trivially_destructible_v<optional<nontrivial_destructor>>);
+    }
+
+    SECTION("can be memcpy'd") {
+        optional<point> from[3] = { point{1, 2}, std::nullopt, point{3, 4} };
+        optional<point> to[3];
+        std::memcpy(to, from, sizeof(from));
+        REQUIRE(to[0]->y == 2);
+        REQUIRE(to[1].has_value() == false);
+        REQUIRE(to[2]->x == 3);
+    }
+
+    SECTION("std::copy") {
+        optional<int> from[3] = { 1, std::nullopt, 3 };
+        optional<int> to[3] = { 7, 8, 9 };
+        std::copy(std::begin(from), std::end(from), std::begin(to));
+        REQUIRE(to[0].value() == 1);
+        REQUIRE(to[1].has_value() == false);
+        REQUIRE(to[2].value() == 3);
+    }
+}
+
+namespace {
+    struct large {
+        char data[4096];
+    };
+}
+
+TEST_CASE("optional reference") {
+    SECTION("is a pointer") {
+        static_assert(sizeof(optional<large&>) == sizeof(large*));
+        static_assert(std::is_trivially_copyable_v<optional<const large&>>);
+    }
+
+    SECTION("binds to lvalues only") {
+        static_assert(std::is_constructible_v<optional<const string&>, string&>);
+        static_assert(std::is_constructible_v<optional<const string&>, const string&>);
+        static_assert(!std::is_constructible_v<optional<string&>, const string&>);
+        static_assert(!std::is_constructible_v<optional<const string&>, string&&>);
+        static_assert(!std::is_constructible_v<optional<const string&>, const char*>);
+        static_assert(!std::is_constructible_v<optional<const string&>, optional<string>&&>);
+    }
+
+    SECTION("refers to the value") {
+        string s("foo");
+        optional<string&> r(s);
+        REQUIRE(&r.value() == &s);
+        *r += "bar";
+        REQUIRE(s == "foobar");
+        REQUIRE(r->size() == 6);
+
+        optional<string&> empty;
+        REQUIRE(empty.has_value() == false);
+        REQUIRE_THROWS_AS(empty.value(), std::bad_optional_access);
+    }
+
+    SECTION("assignment rebinds") {
+        string foo("foo");
+        string bar("bar");
+        optional<string&> r(foo);
+        r = optional<string&>(bar);
+        REQUIRE(&*r == &bar);
+        REQUIRE(foo == "foo");
+        REQUIRE(&r.emplace(foo) == &foo);
+        r = std::nullopt;
+        REQUIRE(r.has_value() == false);
+        REQUIRE(bar == "bar");
+    }
+
+    SECTION("from optional") {
+        optional<string> o("foo");
+        optional<const string&> r(o);
+        REQUIRE(&*r == &*o);
+        optional<string> e;
+        REQUIRE(optional<const string&>(e).has_value() == false);
+
+        optional<string> copy = r;
+        REQUIRE(copy.value() == "foo");
+    }
+
+    SECTION("transform, transform_optional and call") {
+        optional<probe> o(std::in_place, 2);
+        optional<const probe&> r(o);
+        probe::reset();
+        REQUIRE(r.transform([](const probe& p){ return p.value*2;}).value() == 4);
+        REQUIRE(r.transform_optional([](const probe& p){ return optional(p.value*3);}).value() == 6);
+        int result = 0;
+        optional<const probe&>(o).call([&result](const probe& p){ result = p.value;});
+        REQUIRE(result == 2);
+        REQUIRE(probe::count().copies == 0);
+        REQUIRE(probe::count().moves == 0);
+
+        optional<const probe&> empty;
+        REQUIRE(empty.transform([](const probe& p){ return p.value;}).has_value() == false);
+    }
+
+    SECTION("from a lookup") {
+        std::vector<large> cache(3);
+        cache[1].data[0] = 'x';
+        auto find = [&cache](std::size_t i) -> optional<const large&> {
+            if (i < cache.size()) {
+                return cache[i];
+            }
+            return std::nullopt;
+        };
+        REQUIRE(find(1).transform([](const large& l){ return l.data[0];}).value() == 'x');
+        REQUIRE(find(3).has_value() == false);
+    }
+}
+
+namespace {
+    struct document {
+        explicit document(int i) : id(i) { }
+        int id;
+        char text[4096] = {};
+    };
+
+    struct boxed_probe : probe {
+        using probe::probe;
+    };
+
+    struct throwing_move_document {
+        throwing_move_document() = default;
+        throwing_move_document(const throwing_move_document&) = default;
+        throwing_move_document(throwing_move_document&&) noexcept(false) { }
+        char text[4096] = {};
+    };
+}
+
+template <> struct knatten::box_traits<document> : knatten::pooled_box<> { };
+template <> struct knatten::box_traits<boxed_probe> : knatten::pooled_box<> { };
+template <> struct knatten::box_traits<throwing_move_document> : knatten::pooled_box<> { };
+
+TEST_CASE("boxed storage") {
+    SECTION("is a pointer") {
+        static_assert(sizeof(optional<document>) == sizeof(document*));
+        static_assert(std::is_nothrow_move_constructible_v<optional<throwing_move_document>>);
+        std::vector<optional<document>> sparse(100);
+        sparse[42] = document(42);
+        REQUIRE(sparse[42]->id == 42);
+        REQUIRE(sparse[41].has_value() == false);
+    }
+
+    SECTION("constructors and assignment") {
+        optional<document> o(std::in_place, 1);
+        optional<document> copy(o);
+        REQUIRE(copy->id == 1);
+        REQUIRE(&*copy != &*o);
+
+        const document* p = &*o;
+        optional<document> moved(std::move(o));
+        REQUIRE(&*moved == p);
+        REQUIRE(o.has_value() == false);
+
+        copy = moved;
+        REQUIRE(copy->id == 1);
+        copy = std::nullopt;
+        REQUIRE(copy.has_value() == false);
+        copy.emplace(2);
+        REQUIRE(copy.value().id == 2);
+        copy.reset();
+        REQUIRE_THROWS_AS(copy.value(), std::bad_optional_access);
+    }
+
+    SECTION("vector growth moves the pointers") {
+        std::vector<optional<throwing_move_document>> v;
+        v.emplace_back(std::in_place);
+        const throwing_move_document* p = &*v[0];
+        for (int i = 0; i < 100; ++i) {
+            v.emplace_back(std::in_place);
+        }
+        REQUIRE(&*v[0] == p);
+    }
+
+    SECTION("transform allocates") {
+        //Even with KNATTEN_OPTIONAL_CONDITIONAL_NOEXCEPT, as allocating the block may throw
+        optional<document> o(std::in_place, 1);
+        auto nothrow_next = [](const document& d) noexcept { return document(d.id + 1);};
+        auto nothrow_make = [](int i) noexcept { return document(i);};
+        static_assert(!noexcept(o.transform(nothrow_next)));
+        static_assert(!noexcept(std::move(o).transform(nothrow_next)));
+        static_assert(!noexcept(optional(1).transform(nothrow_make)));
+#ifdef KNATTEN_OPTIONAL_CONDITIONAL_NOEXCEPT
+        //A result that is not boxed needs no block
+        static_assert(noexcept(o.transform(&document::id)));
+#endif
+    }
+
+    SECTION("transform") {
+        optional<document> o(std::in_place, 1);
+        auto next = [](const document& d){ return document(d.id + 1);};
+        REQUIRE(o.transform(next)->id == 2);
+        REQUIRE(o.has_value());
+        REQUIRE(std::move(o).transform(next)->id == 2);
+        REQUIRE(o.has_value() == false);
+        REQUIRE(optional<document>().transform(next).has_value() == false);
+    }
+
+    SECTION("rvalue transform reuses the block") {
+        optional<document> o(std::in_place, 1);
+        auto next = [](document&& d){ return document(d.id + 1);};
+        optional<document> p = std::move(o).transform(next);
+        const document* first = &*p;
+        //The first transform empties p, so the second one gets its block back from the pool
+        p = std::move(p).transform(next).transform(next);
+        REQUIRE(p->id == 4);
+        REQUIRE(&*p == first);
+    }
+
+    SECTION("copies and moves") {
+        optional<boxed_probe> o(std::in_place, 1);
+        probe::reset();
+        optional<boxed_probe> moved(std::move(o));
+        auto p = std::move(moved).transform([](boxed_probe&& v){ return boxed_probe(v.value + 1);});
+        REQUIRE(p->value == 2);
+        REQUIRE(probe::count().copies == 0);
+        REQUIRE(probe::count().moves == 0);
+        REQUIRE(probe::count().constructions == 1);
+        REQUIRE(probe::count().destructions == 1);
+    }
+}
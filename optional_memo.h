@@ -0,0 +1,117 @@
+#ifndef OPTIONAL_MEMO_H
+#define OPTIONAL_MEMO_H
+#include "optional_ext.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace knatten {
+    //A function object caching the results of op in a bounded table, for use with transform and
+    //transform_optional when the same values come up over and over:
+    //    auto author_of = memoized<tweet>(lookup_author, 4096);
+    //    auto a = find_first("foo").transform(author_of);
+    //Pass it as an lvalue, transform then uses it by reference and every call shares the cache.
+    //
+    //The table is set-associative: a key hashes to a set of 8 adjacent slots and is looked up
+    //only there, and when the set is full a CLOCK hand per set evicts a slot that was not used
+    //since the hand last passed it. op must be pure, a hit returns a copy of the cached result.
+    //A memoizer is not thread-safe.
+    template <class Key, class F, class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key>>
+    class memoizer {
+    public:
+        using result_type = detail::remove_cvref_t<detail::invoke_result_t<F&, const Key&>>;
+
+        //Room for at least capacity results
+        memoizer(F op, std::size_t capacity, Hash hash = Hash(), KeyEqual equal = KeyEqual())
+            : op_(std::move(op)), hash_(std::move(hash)), equal_(std::move(equal)),
+              shift_(set_shift(capacity)), slots_(set_count() * ways), hands_(set_count()) { }
+
+        result_type operator()(const Key& key) {
+            std::size_t set = set_of(key);
+            slot* first = &slots_[set * ways];
+            for (slot* s = first; s != first + ways; ++s) {
+                if (s->e.has_value() && equal_(s->e->key, key)) {
+                    s->referenced = true;
+                    ++hits_;
+                    return s->e->value;
+                }
+            }
+            ++misses_;
+            result_type value = detail::invoke(op_, key);
+            slot& victim = evict(first, hands_[set]);
+            victim.e.emplace(key, std::move(value));
+            victim.referenced = true;
+            return victim.e->value;
+        }
+
+        std::size_t capacity() const noexcept { return slots_.size(); }
+        std::uint64_t hits() const noexcept { return hits_; }
+        std::uint64_t misses() const noexcept { return misses_; }
+
+    private:
+        static constexpr std::size_t ways = 8;
+
+        struct entry {
+            entry(const Key& k, result_type&& v) : key(k), value(std::move(v)) { }
+            Key key;
+            result_type value;
+        };
+
+        struct slot {
+            optional<entry> e{};
+            bool referenced = false;
+        };
+
+        //The number of sets is a power of two, so a set is picked by the top bits of a
+        //multiplicative hash, which also spreads out std::hash's identity for integers
+        static unsigned set_shift(std::size_t capacity) noexcept {
+            unsigned bits = 0;
+            while ((std::size_t(1) << bits) * ways < capacity) {
+                ++bits;
+            }
+            return 64 - bits;
+        }
+
+        std::size_t set_count() const noexcept { return std::size_t(1) << (64 - shift_); }
+
+        std::size_t set_of(const Key& key) const {
+            std::uint64_t h = static_cast<std::uint64_t>(hash_(key)) * 0x9e3779b97f4a7c15ull;
+            return shift_ == 64 ? 0 : static_cast<std::size_t>(h >> shift_);
+        }
+
+        //An empty slot in the set if there is one, otherwise the first slot after hand that has
+        //not been referenced, clearing the referenced bits passed on the way
+        static slot& evict(slot* first, unsigned char& hand) noexcept {
+            for (slot* s = first; s != first + ways; ++s) {
+                if (!s->e.has_value()) {
+                    return *s;
+                }
+            }
+            for (;;) {
+                slot& s = first[hand];
+                hand = static_cast<unsigned char>((hand + 1) % ways);
+                if (!s.referenced) {
+                    return s;
+                }
+                s.referenced = false;
+            }
+        }
+
+        F op_;
+        Hash hash_;
+        KeyEqual equal_;
+        unsigned shift_;
+        std::vector<slot> slots_;
+        std::vector<unsigned char> hands_;
+        std::uint64_t hits_ = 0;
+        std::uint64_t misses_ = 0;
+    };
+
+    template <class Key, class F>
+    memoizer<Key, std::decay_t<F>> memoized(F&& op, std::size_t capacity) {
+        return memoizer<Key, std::decay_t<F>>(std::forward<F>(op), capacity);
+    }
+}
+#endif
@@ -0,0 +1,62 @@
+#include "optional_memo.h"
+#include "catch.hpp"
+
+#include <string>
+
+using std::string;
+using knatten::optional;
+using knatten::memoized;
+
+TEST_CASE("memoized transform") {
+    int calls = 0;
+    auto square = memoized<int>([&calls](int v){ ++calls; return v*v;}, 64);
+
+    SECTION("caches results") {
+        REQUIRE(optional(3).transform(square).value() == 9);
+        REQUIRE(optional(3).transform(square).value() == 9);
+        REQUIRE(optional(4).transform(square).value() == 16);
+        REQUIRE(calls == 2);
+        REQUIRE(square.hits() == 1);
+        REQUIRE(square.misses() == 2);
+    }
+
+    SECTION("with no value") {
+        REQUIRE(optional<int>().transform(square).has_value() == false);
+        REQUIRE(calls == 0);
+        REQUIRE(square.misses() == 0);
+    }
+
+    SECTION("is bounded") {
+        REQUIRE(square.capacity() >= 64);
+        for (int round = 0; round < 2; ++round) {
+            for (int i = 0; i < 1000; ++i) {
+                REQUIRE(optional(i).transform(square).value() == i*i);
+            }
+        }
+        REQUIRE(square.hits() + square.misses() == 2000);
+        REQUIRE(square.misses() > 1000);
+    }
+
+    SECTION("keeps referenced entries") {
+        //A small hot set survives a stream of values that are used only once
+        for (int i = 0; i < 10000; ++i) {
+            optional(i % 4).transform(square);
+            optional(1000 + i).transform(square);
+        }
+        REQUIRE(square.hits() > 9900);
+    }
+}
+
+TEST_CASE("memoized transform_optional") {
+    int calls = 0;
+    auto parse = memoized<string>([&calls](const string& s) {
+        ++calls;
+        return s.empty() ? optional<int>() : optional(static_cast<int>(s.size()));
+    }, 16);
+
+    REQUIRE(optional<string>("foo").transform_optional(parse).value() == 3);
+    REQUIRE(optional<string>("").transform_optional(parse).has_value() == false);
+    REQUIRE(optional<string>("foo").transform_optional(parse).value() == 3);
+    REQUIRE(optional<string>("").transform_optional(parse).has_value() == false);
+    REQUIRE(calls == 2);
+}
@@ -0,0 +1,165 @@
+#ifndef OPTIONAL_PIPELINE_H
+#define OPTIONAL_PIPELINE_H
+#include "optional_ext.h"
+#include <cstddef>
+#include <functional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace knatten {
+    namespace detail {
+        template <class UnaryOperation>
+        struct transform_stage { UnaryOperation op; };
+
+        template <class UnaryOperation>
+        struct transform_optional_stage { UnaryOperation op; };
+
+        //The value type left over after running Stages on a V
+        template <class V, class... Stages>
+        struct pipeline_value { using type = std::decay_t<V>; };
+
+        template <class V, class UnaryOperation, class... Rest>
+        struct pipeline_value<V, transform_stage<UnaryOperation>, Rest...>
+            : pipeline_value<detail::invoke_result_t<UnaryOperation&, V>, Rest...> { };
+
+        template <class V, class UnaryOperation, class... Rest>
+        struct pipeline_value<V, transform_optional_stage<UnaryOperation>, Rest...>
+            : pipeline_value<decltype(*std::declval<detail::invoke_result_t<UnaryOperation&, V>>()), Rest...> { };
+    }
+
+    //A lazy chain of transform/transform_optional stages on top of a source optional.
+    //Nothing runs until eval() or call(), at which point the source is tested once,
+    //every transform stage feeds its result straight into the next one, and only
+    //the final optional is constructed, in place from the result of the last stage.
+    //transform_optional stages still need their own presence check, since op itself
+    //may return an empty optional.
+    //
+    //An lvalue source is held by reference, an rvalue source is moved into the pipeline.
+    template <class Source, class... Stages>
+    class pipeline {
+    public:
+        using value_type = typename detail::pipeline_value<
+            decltype(*std::declval<Source>()), Stages...>::type;
+        using result_type = optional<value_type>;
+
+        constexpr pipeline(Source&& source, std::tuple<Stages...> stages)
+            : source_(std::forward<Source>(source)), stages_(std::move(stages)) { }
+
+        template <class UnaryOperation>
+        constexpr auto transform(UnaryOperation op) && {
+            return append(detail::transform_stage<UnaryOperation>{std::move(op)});
+        }
+
+        template <class UnaryOperation>
+        constexpr auto transform_optional(UnaryOperation op) && {
+            return append(detail::transform_optional_stage<UnaryOperation>{std::move(op)});
+        }
+
+        template <class UnaryOperation>
+        constexpr void call(UnaryOperation op) && {
+            call_sink<UnaryOperation> sink{op};
+            evaluate(sink);
+        }
+
+        constexpr result_type eval() && {
+            eval_sink sink;
+            return evaluate(sink);
+        }
+
+        constexpr operator result_type() && {
+            return std::move(*this).eval();
+        }
+
+    private:
+        struct eval_sink {
+            using result_type = pipeline::result_type;
+
+            template <class V>
+            constexpr result_type finish(V&& v) { return result_type(std::forward<V>(v)); }
+
+            template <class UnaryOperation, class V>
+            constexpr result_type finish_invoke(UnaryOperation& op, V&& v) {
+                return result_type(in_place_invoke, op, std::forward<V>(v));
+            }
+
+            constexpr result_type finish_optional(result_type&& r) { return std::move(r); }
+        };
+
+        template <class UnaryOperation>
+        struct call_sink {
+            using result_type = void;
+            UnaryOperation& op;
+
+            template <class V>
+            constexpr void finish(V&& v) { detail::invoke(op, std::forward<V>(v)); }
+
+            template <class Stage, class V>
+            constexpr void finish_invoke(Stage& stage_op, V&& v) { detail::invoke(op, detail::invoke(stage_op, std::forward<V>(v))); }
+
+            template <class OptionalType>
+            constexpr void finish_optional(OptionalType&& r) {
+                if (r.has_value()) {
+                    detail::invoke(op, *std::move(r));
+                }
+            }
+        };
+
+        template <class Stage>
+        constexpr auto append(Stage&& stage) {
+            return pipeline<Source, Stages..., Stage>(
+                std::forward<Source>(source_),
+                std::tuple_cat(std::move(stages_), std::tuple<Stage>(std::move(stage))));
+        }
+
+        template <class Sink>
+        constexpr typename Sink::result_type evaluate(Sink& sink) {
+            if (!source_.has_value()) {
+                return typename Sink::result_type();
+            }
+            return run<0>(sink, *std::forward<Source>(source_));
+        }
+
+        template <std::size_t I, class Sink, class V>
+        constexpr typename Sink::result_type run(Sink& sink, V&& v) {
+            if constexpr (I == sizeof...(Stages)) {
+                return sink.finish(std::forward<V>(v));
+            } else {
+                return step<I>(sink, std::get<I>(stages_), std::forward<V>(v));
+            }
+        }
+
+        template <std::size_t I, class Sink, class UnaryOperation, class V>
+        constexpr typename Sink::result_type step(Sink& sink, detail::transform_stage<UnaryOperation>& stage, V&& v) {
+            if constexpr (I + 1 == sizeof...(Stages)) {
+                return sink.finish_invoke(stage.op, std::forward<V>(v));
+            } else {
+                return run<I + 1>(sink, detail::invoke(stage.op, std::forward<V>(v)));
+            }
+        }
+
+        template <std::size_t I, class Sink, class UnaryOperation, class V>
+        constexpr typename Sink::result_type step(Sink& sink, detail::transform_optional_stage<UnaryOperation>& stage, V&& v) {
+            auto r = detail::invoke(stage.op, std::forward<V>(v));
+            if constexpr (I + 1 == sizeof...(Stages)) {
+                return sink.finish_optional(std::move(r));
+            } else {
+                if (!r.has_value()) {
+                    return typename Sink::result_type();
+                }
+                return run<I + 1>(sink, *std::move(r));
+            }
+        }
+
+        Source source_;
+        std::tuple<Stages...> stages_;
+    };
+
+    //Start a lazy pipeline, e.g.
+    //    optional<author> a = lazy(find_first("foo")).transform_optional(tweet_replied_to).transform(lookup_author);
+    template <class OptionalType>
+    constexpr pipeline<OptionalType> lazy(OptionalType&& o) {
+        return pipeline<OptionalType>(std::forward<OptionalType>(o), std::tuple<>());
+    }
+}
+#endif
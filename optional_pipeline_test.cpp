@@ -0,0 +1,135 @@
+#include "optional_pipeline.h"
+#include "catch.hpp"
+#include "probe.h"
+
+#include <string>
+
+using std::string;
+using knatten::optional;
+using knatten::lazy;
+
+TEST_CASE("lazy transform") {
+    SECTION("with lvalue") {
+        optional o(2);
+        optional<int> p = lazy(o)
+            .transform([](int& v){ return v*2;})
+            .transform([](int&& v){ return v+1;});
+        REQUIRE(p.value() == 5);
+        REQUIRE(o.value() == 2);
+    }
+
+    SECTION("with rvalue") {
+        auto p = lazy(optional<string>("foo"))
+            .transform([](string&& s){ return s + "bar";})
+            .transform([](const string& s){ return s.size();})
+            .eval();
+        REQUIRE(p.value() == 6);
+    }
+
+    SECTION("without stages") {
+        const optional o(3);
+        optional<int> p = lazy(o);
+        REQUIRE(p.value() == 3);
+    }
+
+    SECTION("with no value") {
+        int calls = 0;
+        optional<int> p = lazy(optional<int>())
+            .transform([&calls](int v){ ++calls; return v*2;})
+            .transform([&calls](int v){ ++calls; return v*2;});
+        REQUIRE(p.has_value() == false);
+        REQUIRE(calls == 0);
+    }
+}
+
+TEST_CASE("lazy transform_optional") {
+    SECTION("with value") {
+        optional<int> p = lazy(optional(2))
+            .transform([](int v){ return v*2;})
+            .transform_optional([](int v){ return optional(v+1);})
+            .transform([](int v){ return v*3;});
+        REQUIRE(p.value() == 15);
+    }
+
+    SECTION("as the last stage") {
+        optional<int> p = lazy(optional(2))
+            .transform_optional([](int v){ return optional(v*2);});
+        REQUIRE(p.value() == 4);
+    }
+
+    SECTION("returning no value") {
+        int calls = 0;
+        optional<int> p = lazy(optional(2))
+            .transform_optional([](int){ return optional<int>();})
+            .transform([&calls](int v){ ++calls; return v;});
+        REQUIRE(p.has_value() == false);
+        REQUIRE(calls == 0);
+    }
+}
+
+TEST_CASE("lazy call") {
+    SECTION("with value") {
+        int result = 0;
+        lazy(optional(2))
+            .transform([](int v){ return v*2;})
+            .call([&result](int v){ result = v;});
+        REQUIRE(result == 4);
+    }
+
+    SECTION("after transform_optional") {
+        int result = 0;
+        lazy(optional(2))
+            .transform_optional([](int v){ return optional(v*3);})
+            .call([&result](int v){ result = v;});
+        REQUIRE(result == 6);
+    }
+
+    SECTION("with no value") {
+        bool called = false;
+        lazy(optional<int>())
+            .transform([](int v){ return v*2;})
+            .call([&called](int){ called = true;});
+        REQUIRE(called == false);
+    }
+}
+
+TEST_CASE("lazy transform constructs the result in place") {
+    struct immovable {
+        explicit immovable(int v) : value(v) { }
+        immovable(immovable&&) = delete;
+        int value;
+    };
+    optional<immovable> p = lazy(optional(2))
+        .transform([](int v){ return v*2;})
+        .transform([](int v){ return immovable(v+1);});
+    REQUIRE(p->value == 5);
+}
+
+TEST_CASE("lazy transform copies and moves") {
+    optional<probe> o(std::in_place, 1);
+    probe::reset();
+    {
+        optional<probe> p = lazy(o)
+            .transform([](const probe& v){ return probe(v.value + 1);})
+            .transform([](probe&& v){ return probe(v.value + 1);})
+            .transform([](probe&& v){ return probe(v.value + 1);});
+        REQUIRE(p->value == 4);
+    }
+    REQUIRE(probe::count().constructions == 3);
+    REQUIRE(probe::count().copies == 0);
+    REQUIRE(probe::count().moves == 0);
+    REQUIRE(probe::count().destructions == 3);
+}
+
+TEST_CASE("lazy transform with member pointers") {
+    struct record {
+        string name;
+        std::size_t size() const { return name.size(); }
+    };
+    optional<std::size_t> size = lazy(optional(record{"foo"}))
+        .transform([](record&& r){ return std::move(r);})
+        .transform(&record::size);
+    REQUIRE(size.value() == 3);
+    optional<string> name = lazy(optional(record{"bar"})).transform(&record::name);
+    REQUIRE(name.value() == "bar");
+}
@@ -0,0 +1,230 @@
+#ifndef OPTIONAL_PMR_H
+#define OPTIONAL_PMR_H
+#include "optional_ext.h"
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+//knatten::pmr::optional<T>, an allocator-aware optional<T> for payloads like std::pmr::string
+//and std::pmr::vector. It holds a std::pmr::polymorphic_allocator and constructs its value with
+//uses-allocator construction, so the value allocates from the optional's memory resource.
+//transform and transform_optional return a pmr::optional using the same resource as the source,
+//so a pipeline started on a per-request arena keeps every result in that arena:
+//    std::pmr::monotonic_buffer_resource arena;
+//    pmr::optional<std::pmr::string> name(std::allocator_arg, &arena, std::in_place, "foo");
+//    auto upper = name.transform(to_upper);      //Also allocates from arena
+//A result op returns is moved into place with the resource, which is a plain move if op built it
+//with get_allocator(), and a copy into the arena otherwise. A result not using an allocator is
+//constructed in place straight from op, like knatten::optional's transform does.
+//
+//Like the std::pmr containers, copy construction uses the default resource, move construction
+//keeps the source's, and assignment never changes the resource of the target.
+namespace knatten {
+    namespace detail {
+        //Whether T can be uses-allocator constructed from Args
+        template <class T, class Alloc, class... Args>
+        inline constexpr bool constructible_using_allocator = std::uses_allocator_v<T, Alloc> ?
+            std::is_constructible_v<T, std::allocator_arg_t, const Alloc&, Args&&...> ||
+            std::is_constructible_v<T, Args&&..., const Alloc&> :
+            std::is_constructible_v<T, Args&&...>;
+
+        //Constructs the value of o from args, passing alloc along if T uses an allocator
+        template <class T, class Alloc, class... Args>
+        T& emplace_using_allocator(optional<T>& o, const Alloc& alloc, Args&&... args) {
+            if constexpr (!std::uses_allocator_v<T, Alloc>) {
+                return o.emplace(std::forward<Args>(args)...);
+            } else if constexpr (std::is_constructible_v<T, std::allocator_arg_t, const Alloc&, Args&&...>) {
+                return o.emplace(std::allocator_arg, alloc, std::forward<Args>(args)...);
+            } else {
+                static_assert(std::is_constructible_v<T, Args&&..., const Alloc&>,
+                              "T uses an allocator but can not be constructed with one");
+                return o.emplace(std::forward<Args>(args)..., alloc);
+            }
+        }
+    }
+
+    namespace pmr {
+        template <class T>
+        class optional {
+        public:
+            using value_type = T;
+            using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+            optional() noexcept = default;
+            optional(std::nullopt_t) noexcept { }
+            explicit optional(const allocator_type& alloc) noexcept : alloc_(alloc) { }
+
+            template <class... Args, std::enable_if_t<
+                detail::constructible_using_allocator<T, allocator_type, Args...>, int> = 0>
+            explicit optional(std::in_place_t, Args&&... args) {
+                emplace(std::forward<Args>(args)...);
+            }
+
+            template <class... Args, std::enable_if_t<
+                detail::constructible_using_allocator<T, allocator_type, Args...>, int> = 0>
+            optional(std::allocator_arg_t, const allocator_type& alloc, std::in_place_t, Args&&... args) : alloc_(alloc) {
+                emplace(std::forward<Args>(args)...);
+            }
+
+            optional(const optional& rhs) : optional(rhs, allocator_type()) { }
+
+            optional(const optional& rhs, const allocator_type& alloc) : alloc_(alloc) {
+                if (rhs.has_value()) {
+                    emplace(*rhs);
+                }
+            }
+
+            optional(optional&& rhs) noexcept(std::is_nothrow_move_constructible_v<T>)
+                : alloc_(rhs.alloc_), o_(std::move(rhs.o_)) { }
+
+            optional(optional&& rhs, const allocator_type& alloc) : alloc_(alloc) {
+                if (rhs.has_value()) {
+                    emplace(*std::move(rhs));
+                }
+            }
+
+            optional& operator=(const optional& rhs) {
+                assign(rhs);
+                return *this;
+            }
+
+            optional& operator=(optional&& rhs) {
+                if (alloc_ == rhs.alloc_) {
+                    o_ = std::move(rhs.o_);
+                } else {
+                    assign(std::move(rhs));
+                }
+                return *this;
+            }
+
+            optional& operator=(std::nullopt_t) noexcept {
+                reset();
+                return *this;
+            }
+
+            allocator_type get_allocator() const noexcept { return alloc_; }
+
+            //Destroys any current value and uses-allocator constructs a new one from args
+            template <class... Args>
+            T& emplace(Args&&... args) {
+                return detail::emplace_using_allocator(o_, alloc_, std::forward<Args>(args)...);
+            }
+
+            void reset() noexcept { o_.reset(); }
+
+            template <class UnaryOperation>
+            auto transform(UnaryOperation&& op) & { return transform_impl(*this, std::forward<UnaryOperation>(op)); }
+
+            template <class UnaryOperation>
+            auto transform(UnaryOperation&& op) const& { return transform_impl(*this, std::forward<UnaryOperation>(op)); }
+
+            template <class UnaryOperation>
+            auto transform(UnaryOperation&& op) && { return transform_impl(std::move(*this), std::forward<UnaryOperation>(op)); }
+
+            template <class UnaryOperation>
+            auto transform(UnaryOperation&& op) const&& { return transform_impl(std::move(*this), std::forward<UnaryOperation>(op)); }
+
+            template <class UnaryOperation>
+            auto transform_optional(UnaryOperation&& op) & { return transform_optional_impl(*this, std::forward<UnaryOperation>(op)); }
+
+            template <class UnaryOperation>
+            auto transform_optional(UnaryOperation&& op) const& { return transform_optional_impl(*this, std::forward<UnaryOperation>(op)); }
+
+            template <class UnaryOperation>
+            auto transform_optional(UnaryOperation&& op) && { return transform_optional_impl(std::move(*this), std::forward<UnaryOperation>(op)); }
+
+            template <class UnaryOperation>
+            auto transform_optional(UnaryOperation&& op) const&& { return transform_optional_impl(std::move(*this), std::forward<UnaryOperation>(op)); }
+
+            template <class UnaryOperation>
+            void call(UnaryOperation&& op) & { o_.call(std::forward<UnaryOperation>(op)); }
+
+            template <class UnaryOperation>
+            void call(UnaryOperation&& op) const& { o_.call(std::forward<UnaryOperation>(op)); }
+
+            template <class UnaryOperation>
+            void call(UnaryOperation&& op) && { std::move(o_).call(std::forward<UnaryOperation>(op)); }
+
+            template <class UnaryOperation>
+            void call(UnaryOperation&& op) const&& { std::move(o_).call(std::forward<UnaryOperation>(op)); }
+
+            bool has_value() const noexcept { return o_.has_value(); }
+
+            const T& value() const& { return o_.value(); }
+            T& value() & { return o_.value(); }
+            T&& value() && { return std::move(o_).value(); }
+            const T&& value() const&& { return std::move(o_).value(); }
+
+            const T& operator*() const& { return *o_; }
+            T& operator*() & { return *o_; }
+            const T&& operator*() const&& { return *std::move(o_); }
+            T&& operator*() && { return *std::move(o_); }
+
+            const T* operator->() const { return o_.operator->(); }
+            T* operator->() { return o_.operator->(); }
+
+        private:
+            template <class U>
+            friend class optional;
+
+            template <class Other>
+            void assign(Other&& rhs) {
+                if (!rhs.has_value()) {
+                    reset();
+                } else if (has_value()) {
+                    *o_ = *std::forward<Other>(rhs);
+                } else {
+                    emplace(*std::forward<Other>(rhs));
+                }
+            }
+
+            //Constructs the value from f(args...) in place, for a T not using an allocator
+            template <class F, class... Args>
+            optional(const allocator_type& alloc, in_place_invoke_t, F&& f, Args&&... args)
+                : alloc_(alloc), o_(in_place_invoke, std::forward<F>(f), std::forward<Args>(args)...) { }
+
+            //The result of op is moved into a value constructed with the source's allocator if it
+            //uses one, and constructed in place otherwise
+            template <class Self, class UnaryOperation>
+            static auto transform_impl(Self&& self, UnaryOperation&& op) {
+                using ValueType = detail::remove_cvref_t<
+                    detail::invoke_result_t<UnaryOperation, decltype(*std::forward<Self>(self).o_)>>;
+                if constexpr (!std::uses_allocator_v<ValueType, allocator_type>) {
+                    if (!self.has_value()) {
+                        return optional<ValueType>(self.alloc_);
+                    }
+                    return optional<ValueType>(self.alloc_, in_place_invoke,
+                        std::forward<UnaryOperation>(op), *std::forward<Self>(self).o_);
+                } else {
+                    optional<ValueType> result(self.alloc_);
+                    if (self.has_value()) {
+                        result.emplace(detail::invoke(std::forward<UnaryOperation>(op), *std::forward<Self>(self).o_));
+                    }
+                    return result;
+                }
+            }
+
+            //op may return any optional, its value is moved into one with the source's allocator
+            template <class Self, class UnaryOperation>
+            static auto transform_optional_impl(Self&& self, UnaryOperation&& op) {
+                using OptionalType = detail::invoke_result_t<UnaryOperation, decltype(*std::forward<Self>(self).o_)>;
+                using ValueType = detail::remove_cvref_t<decltype(*std::declval<OptionalType>())>;
+                optional<ValueType> result(self.alloc_);
+                if (self.has_value()) {
+                    OptionalType r = detail::invoke(std::forward<UnaryOperation>(op), *std::forward<Self>(self).o_);
+                    if (r.has_value()) {
+                        result.emplace(*std::move(r));
+                    }
+                }
+                return result;
+            }
+
+            allocator_type alloc_{};
+            knatten::optional<T> o_{};
+        };
+    }
+}
+#endif
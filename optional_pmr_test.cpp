@@ -0,0 +1,158 @@
+#include "optional_pmr.h"
+#include "catch.hpp"
+#include "probe.h"
+
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+using knatten::pmr::optional;
+
+namespace {
+    //Counts the allocations made through it, and passes them on to upstream
+    class counting_resource : public std::pmr::memory_resource {
+    public:
+        explicit counting_resource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+            : upstream_(upstream) { }
+        counting_resource(const counting_resource&) = delete;
+        counting_resource& operator=(const counting_resource&) = delete;
+
+        int allocations = 0;
+
+    private:
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+            ++allocations;
+            return upstream_->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+            upstream_->deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        std::pmr::memory_resource* upstream_;
+    };
+
+    //Makes r the default resource for as long as it lives
+    struct default_resource_guard {
+        explicit default_resource_guard(std::pmr::memory_resource* r) : previous(std::pmr::set_default_resource(r)) { }
+        ~default_resource_guard() { std::pmr::set_default_resource(previous); }
+        default_resource_guard(const default_resource_guard&) = delete;
+        default_resource_guard& operator=(const default_resource_guard&) = delete;
+        std::pmr::memory_resource* previous;
+    };
+
+    const char* long_string = "long enough to not fit in the small string buffer";
+}
+
+TEST_CASE("pmr optional construction") {
+    counting_resource arena;
+
+    SECTION("uses-allocator constructs the value") {
+        optional<std::pmr::string> o(std::allocator_arg, &arena, std::in_place, long_string);
+        REQUIRE(o.value() == long_string);
+        REQUIRE(o->get_allocator().resource() == &arena);
+        REQUIRE(o.get_allocator().resource() == &arena);
+        REQUIRE(arena.allocations == 1);
+    }
+
+    SECTION("with a value not using an allocator") {
+        optional<int> o(std::allocator_arg, &arena, std::in_place, 3);
+        REQUIRE(o.value() == 3);
+        REQUIRE(arena.allocations == 0);
+    }
+
+    SECTION("copy and move") {
+        optional<std::pmr::string> o(std::allocator_arg, &arena, std::in_place, long_string);
+        optional<std::pmr::string> copy(o);
+        REQUIRE(copy->get_allocator().resource() == std::pmr::get_default_resource());
+        optional<std::pmr::string> arena_copy(o, &arena);
+        REQUIRE(arena_copy->get_allocator().resource() == &arena);
+        optional<std::pmr::string> moved(std::move(o));
+        REQUIRE(moved->get_allocator().resource() == &arena);
+        REQUIRE(*moved == long_string);
+    }
+
+    SECTION("assignment keeps the resource") {
+        optional<std::pmr::string> o(std::allocator_arg, &arena, std::in_place, long_string);
+        optional<std::pmr::string> other;
+        other = o;
+        REQUIRE(other.get_allocator().resource() == std::pmr::get_default_resource());
+        REQUIRE(other->get_allocator().resource() == std::pmr::get_default_resource());
+        optional<std::pmr::string> target(&arena);
+        target = std::move(other);
+        REQUIRE(target->get_allocator().resource() == &arena);
+        target = std::nullopt;
+        REQUIRE(target.has_value() == false);
+    }
+
+    SECTION("in a pmr container") {
+        std::pmr::vector<optional<std::pmr::string>> v(&arena);
+        v.emplace_back(std::nullopt);
+        v.emplace_back(std::in_place, long_string);
+        REQUIRE(v[0].get_allocator().resource() == &arena);
+        REQUIRE(v[1]->get_allocator().resource() == &arena);
+    }
+}
+
+TEST_CASE("pmr optional transform") {
+    counting_resource arena;
+    counting_resource heap;
+    default_resource_guard guard(&heap);
+    optional<std::pmr::string> o(std::allocator_arg, &arena, std::in_place, long_string);
+
+    SECTION("transform propagates the resource") {
+        auto doubled = o
+            .transform([](const std::pmr::string& s){ return std::pmr::string(s + s, s.get_allocator());})
+            .transform([](std::pmr::string&& s){ return std::move(s);});
+        REQUIRE(doubled.get_allocator().resource() == &arena);
+        REQUIRE(doubled->get_allocator().resource() == &arena);
+        REQUIRE(doubled->size() == 2 * o->size());
+
+        auto size = o.transform([](const std::pmr::string& s){ return s.size();});
+        REQUIRE(size.value() == o->size());
+        REQUIRE(size.get_allocator().resource() == &arena);
+    }
+
+    SECTION("a result from elsewhere is moved into the arena") {
+        auto copied = o.transform([](const std::pmr::string& s){ return std::pmr::string(s, std::pmr::new_delete_resource());});
+        REQUIRE(copied->get_allocator().resource() == &arena);
+        REQUIRE(*copied == long_string);
+        REQUIRE(heap.allocations == 0);
+    }
+
+    SECTION("a result not using an allocator is constructed in place") {
+        probe::reset();
+        auto p = o.transform([](const std::pmr::string& s){ return probe(static_cast<int>(s.size()));});
+        REQUIRE(p->value == static_cast<int>(o->size()));
+        REQUIRE(p.get_allocator().resource() == &arena);
+        REQUIRE(probe::count().constructions == 1);
+        REQUIRE(probe::count().moves == 0);
+        REQUIRE(probe::count().copies == 0);
+    }
+
+    SECTION("transform_optional propagates the resource") {
+        auto p = o.transform_optional([](const std::pmr::string& s) {
+            return knatten::optional<std::pmr::string>(std::pmr::string(s, std::pmr::new_delete_resource()));
+        });
+        REQUIRE(p->get_allocator().resource() == &arena);
+        auto e = o.transform_optional([](const std::pmr::string&){ return knatten::optional<std::pmr::string>();});
+        REQUIRE(e.has_value() == false);
+        REQUIRE(e.get_allocator().resource() == &arena);
+        REQUIRE(heap.allocations == 0);
+    }
+
+    SECTION("call and no value") {
+        std::size_t size = 0;
+        o.call([&size](const std::pmr::string& s){ size = s.size();});
+        REQUIRE(size == o->size());
+
+        optional<std::pmr::string> empty(&arena);
+        auto p = empty.transform([](const std::pmr::string& s){ return s.size();});
+        REQUIRE(p.has_value() == false);
+        REQUIRE(p.get_allocator().resource() == &arena);
+    }
+}
@@ -0,0 +1,199 @@
+#ifndef OPTIONAL_RANGES_H
+#define OPTIONAL_RANGES_H
+#include "optional_ext.h"
+
+#include <concepts>
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+
+#if !defined(__cpp_lib_ranges)
+#error "optional_ranges.h requires C++20 ranges"
+#endif
+
+//Lazy C++20 range adaptors for ranges of optionals, composing with the std::views ones:
+//    for (const author& a : tweets | views::transform_each(&tweet::author_id)
+//                                  | views::and_then(lookup_author)
+//                                  | views::present) { ... }
+//- views::present skips the empty optionals and gives the values of the rest
+//- views::transform_each(op) gives o.transform(op) for every optional o, empty or not
+//- views::and_then(op) gives o.transform_optional(op) for every optional o
+//Nothing is computed until an element is read, and no intermediate container is made. Like
+//the std::views adaptors they compose without a range too, with each other and with those:
+//    auto authors = views::and_then(lookup_author) | views::present;
+//
+//present over a range storing its optionals is a filter and a transform giving references to
+//the values. Over a range computing them, like transform_each and and_then do, it is an input
+//range which computes each optional once and keeps the current one, so op is never called twice
+//for an element and the values read never dangle.
+namespace knatten {
+    namespace detail {
+        //Base of the range adaptor closures here, which compose with each other and with the
+        //std::views ones using the operators below
+        struct adaptor_closure_base { };
+
+        template <class C>
+        concept adaptor_closure = std::derived_from<remove_cvref_t<C>, adaptor_closure_base>;
+
+        //The closure applying first, then second
+        template <class First, class Second>
+        struct pipe : adaptor_closure_base {
+            template <std::ranges::viewable_range R>
+            constexpr auto operator()(R&& r) const {
+                return std::forward<R>(r) | first | second;
+            }
+
+            First first;
+            Second second;
+        };
+
+        template <std::ranges::viewable_range R, adaptor_closure C>
+        constexpr auto operator|(R&& r, C&& closure) {
+            return std::forward<C>(closure)(std::forward<R>(r));
+        }
+
+        template <class Left, class Right>
+            requires (!std::ranges::range<Left>) && (adaptor_closure<Left> || adaptor_closure<Right>)
+        constexpr auto operator|(Left&& left, Right&& right) {
+            return pipe<std::decay_t<Left>, std::decay_t<Right>>{
+                {}, std::forward<Left>(left), std::forward<Right>(right)};
+        }
+
+        struct has_value_fn {
+            template <class Optional>
+            constexpr bool operator()(const Optional& o) const noexcept { return o.has_value(); }
+        };
+
+        struct present_value_fn {
+            template <class Optional>
+            constexpr decltype(auto) operator()(Optional& o) const { return *o; }
+        };
+
+        //views::present over a range of computed optionals. Like std::ranges::basic_istream_view,
+        //the current element is kept in the view, so it can only be iterated once. The position
+        //is kept there too, and only made in begin(), as the base iterator might not be default
+        //constructible.
+        template <std::ranges::view V>
+        class computed_present_view : public std::ranges::view_interface<computed_present_view<V>> {
+        public:
+            using optional_type = std::ranges::range_value_t<V>;
+            using reference = decltype(*std::declval<optional_type&>());
+            using value_type = remove_cvref_t<reference>;
+
+            class iterator {
+            public:
+                using iterator_concept = std::input_iterator_tag;
+                using difference_type = std::ptrdiff_t;
+                using value_type = computed_present_view::value_type;
+
+                iterator() = default;
+                explicit iterator(computed_present_view& parent) : parent_(&parent) { }
+
+                reference operator*() const { return *parent_->current_; }
+
+                iterator& operator++() {
+                    ++*parent_->it_;
+                    parent_->satisfy();
+                    return *this;
+                }
+
+                //Every copy of an iterator shares the position kept in the view, so this is ++
+                iterator operator++(int) {
+                    ++*this;
+                    return *this;
+                }
+
+                friend bool operator==(const iterator& i, std::default_sentinel_t) { return i.at_end(); }
+
+            private:
+                bool at_end() const { return *parent_->it_ == std::ranges::end(parent_->base_); }
+
+                computed_present_view* parent_ = nullptr;
+            };
+
+            computed_present_view() requires std::default_initializable<V> = default;
+            explicit computed_present_view(V base) : base_(std::move(base)) { }
+
+            iterator begin() {
+                it_.emplace(std::ranges::begin(base_));
+                satisfy();
+                return iterator(*this);
+            }
+
+            std::default_sentinel_t end() const noexcept { return std::default_sentinel; }
+
+        private:
+            //Advances to the next element with a value and keeps it. Emplacing the value rather
+            //than assigning the whole optional lets GCC keep the computed optional in registers,
+            //and works for an optional<const T> or optional<const T&> too.
+            void satisfy() {
+                for (auto& it = *it_; it != std::ranges::end(base_); ++it) {
+                    auto&& o = *it;
+                    if (o.has_value()) {
+                        current_.emplace(*std::move(o));
+                        return;
+                    }
+                }
+            }
+
+            V base_ = V();
+            std::optional<std::ranges::iterator_t<V>> it_{};
+            optional_type current_{};
+        };
+
+        template <class R>
+        computed_present_view(R&&) -> computed_present_view<std::views::all_t<R>>;
+
+        struct present_fn : adaptor_closure_base {
+            template <std::ranges::viewable_range R>
+            constexpr auto operator()(R&& r) const {
+                if constexpr (std::is_lvalue_reference_v<std::ranges::range_reference_t<R>>) {
+                    return std::forward<R>(r) | std::views::filter(has_value_fn{}) |
+                           std::views::transform(present_value_fn{});
+                } else {
+                    return computed_present_view(std::forward<R>(r));
+                }
+            }
+        };
+
+        template <class F>
+        struct transform_each_fn {
+            template <class Optional>
+            constexpr auto operator()(Optional&& o) const {
+                return std::forward<Optional>(o).transform(op);
+            }
+
+            F op;
+        };
+
+        template <class F>
+        struct and_then_fn {
+            template <class Optional>
+            constexpr auto operator()(Optional&& o) const {
+                return std::forward<Optional>(o).transform_optional(op);
+            }
+
+            F op;
+        };
+    }
+
+    namespace views {
+        inline constexpr detail::present_fn present{};
+
+        template <class UnaryOperation>
+        constexpr auto transform_each(UnaryOperation&& op) {
+            return std::views::transform(
+                detail::transform_each_fn<std::decay_t<UnaryOperation>>{std::forward<UnaryOperation>(op)});
+        }
+
+        template <class UnaryOperation>
+        constexpr auto and_then(UnaryOperation&& op) {
+            return std::views::transform(
+                detail::and_then_fn<std::decay_t<UnaryOperation>>{std::forward<UnaryOperation>(op)});
+        }
+    }
+}
+#endif
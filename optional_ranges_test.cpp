@@ -0,0 +1,172 @@
+#include "optional_ranges.h"
+#include "catch.hpp"
+
+#include <algorithm>
+#include <list>
+#include <ranges>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::string;
+using knatten::optional;
+namespace views = knatten::views;
+
+namespace {
+    template <class Range>
+    auto to_vector(Range&& r) {
+        std::vector<std::ranges::range_value_t<Range>> v;
+        for (auto&& e : r) {
+            v.push_back(e);
+        }
+        return v;
+    }
+
+    //The value of each optional in r, or fallback for an empty one
+    template <class Range, class T>
+    std::vector<T> values_or(Range&& r, T fallback) {
+        std::vector<T> v;
+        for (auto&& o : r) {
+            v.push_back(o.has_value() ? T(*o) : fallback);
+        }
+        return v;
+    }
+
+    optional<int> half(int v) {
+        return v % 2 == 0 ? optional(v / 2) : optional<int>();
+    }
+
+    struct tweet {
+        string text;
+        optional<int> author_id;
+
+        optional<int> author() const { return author_id; }
+    };
+
+    const std::vector<string> authors{"foo", "bar"};
+
+    optional<const string&> lookup_author(int id) {
+        return id < static_cast<int>(authors.size()) ? optional<const string&>(authors[id]) : optional<const string&>();
+    }
+}
+
+TEST_CASE("views::present") {
+    std::vector<optional<int>> v{1, {}, 3, {}, {}, 6};
+
+    SECTION("skips empty optionals") {
+        REQUIRE(to_vector(v | views::present) == std::vector<int>{1, 3, 6});
+    }
+
+    SECTION("refers to the stored values") {
+        for (int& i : v | views::present) {
+            i *= 10;
+        }
+        REQUIRE(*v[0] == 10);
+        REQUIRE(*v[5] == 60);
+        REQUIRE(v[1].has_value() == false);
+    }
+
+    SECTION("with no values") {
+        std::vector<optional<int>> empty{{}, {}};
+        REQUIRE(std::ranges::empty(empty | views::present));
+    }
+
+    SECTION("composes with std::views") {
+        auto r = v | std::views::reverse | views::present | std::views::take(2);
+        REQUIRE(to_vector(r) == std::vector<int>{6, 3});
+    }
+
+    SECTION("on a non-random access range") {
+        std::list<optional<string>> l{string("foo"), {}, string("bar")};
+        REQUIRE(to_vector(l | views::present) == std::vector<string>{"foo", "bar"});
+    }
+
+    SECTION("composes with std::views without a range") {
+        auto first_two = std::views::reverse | views::present | std::views::take(2);
+        REQUIRE(to_vector(v | first_two) == std::vector<int>{6, 3});
+    }
+}
+
+TEST_CASE("views::transform_each") {
+    std::vector<optional<int>> v{1, {}, 3};
+    auto r = v | views::transform_each([](int i){ return std::to_string(i);});
+    REQUIRE(values_or(r, string("none")) == std::vector<string>{"1", "none", "3"});
+
+    SECTION("is lazy") {
+        int calls = 0;
+        auto counted = v | views::transform_each([&calls](int i){ ++calls; return i;});
+        REQUIRE(calls == 0);
+        REQUIRE((*counted.begin()).value() == 1);
+        REQUIRE(calls == 1);
+    }
+
+    SECTION("followed by present") {
+        auto values = v | views::transform_each([](int i){ return std::to_string(i);}) | views::present;
+        REQUIRE(to_vector(values) == std::vector<string>{"1", "3"});
+    }
+
+    SECTION("with member pointer") {
+        std::vector<optional<tweet>> tweets{tweet{"foo", 1}, {}, tweet{"bar", {}}};
+        auto texts = tweets | views::transform_each(&tweet::text);
+        REQUIRE(values_or(texts, string("none")) == std::vector<string>{"foo", "none", "bar"});
+    }
+}
+
+TEST_CASE("views::and_then") {
+    std::vector<optional<int>> v{8, {}, 6, 3};
+
+    SECTION("flattens") {
+        REQUIRE(values_or(v | views::and_then(half), -1) == std::vector<int>{4, -1, 3, -1});
+    }
+
+    SECTION("chained") {
+        auto r = v | views::and_then(half) | views::and_then(half) | views::present;
+        REQUIRE(to_vector(r) == std::vector<int>{2});
+    }
+
+    SECTION("followed by present calls op once per element") {
+        int calls = 0;
+        auto r = v | views::and_then([&calls](int i){ ++calls; return half(i);}) | views::present;
+        REQUIRE(to_vector(r) == std::vector<int>{4, 3});
+        REQUIRE(calls == 3);
+    }
+
+    SECTION("followed by present composes with std::views") {
+        auto r = v | views::and_then(half) | views::present | std::views::take(1);
+        static_assert(std::ranges::view<decltype(r)>);
+        REQUIRE(to_vector(r) == std::vector<int>{4});
+    }
+
+    SECTION("followed by present without a range") {
+        auto halves = views::and_then(half) | views::present;
+        REQUIRE(to_vector(v | halves) == std::vector<int>{4, 3});
+        auto quarters = views::and_then(half) | (views::and_then(half) | views::present);
+        REQUIRE(to_vector(v | quarters) == std::vector<int>{2});
+    }
+
+    SECTION("followed by present on an input range") {
+        std::istringstream ss("8 5 6 3");
+        auto r = std::views::istream<int>(ss) | std::views::transform(half) | views::present;
+        REQUIRE(to_vector(r) == std::vector<int>{4, 3});
+    }
+
+    SECTION("followed by present for an optional<const T&>") {
+        std::vector<optional<int>> ids{1, {}, 5, 0};
+        std::vector<const string*> found;
+        for (const string& name : ids | views::and_then(lookup_author) | views::present) {
+            found.push_back(&name);
+        }
+        REQUIRE(found == std::vector<const string*>{&authors[1], &authors[0]});
+    }
+
+    SECTION("followed by present for an optional<const T>") {
+        auto r = v | views::and_then([](int i){ return optional<const int>(i);}) | views::present;
+        REQUIRE(to_vector(r) == std::vector<int>{8, 6, 3});
+    }
+
+    SECTION("with member function") {
+        std::vector<optional<tweet>> tweets{tweet{"foo", 1}, {}, tweet{"bar", {}}};
+        auto ids = tweets | views::and_then(&tweet::author) | views::present;
+        REQUIRE(to_vector(ids) == std::vector<int>{1});
+    }
+}
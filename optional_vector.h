@@ -0,0 +1,277 @@
+#ifndef OPTIONAL_VECTOR_H
+#define OPTIONAL_VECTOR_H
+#include "optional_ext.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace knatten {
+    namespace detail {
+        inline int count_trailing_zeros(std::uint64_t word) noexcept {
+            return __builtin_ctzll(word);
+        }
+
+        inline int popcount(std::uint64_t word) noexcept {
+            return __builtin_popcountll(word);
+        }
+
+        //Kept separate so the restrict-qualified pointers let the compiler vectorise without alias checks
+        template <class T, class U, class UnaryOperation>
+        void transform_lanes(const T* __restrict in, U* __restrict out, std::size_t n, UnaryOperation& op) {
+            for (std::size_t i = 0; i < n; ++i) {
+                out[i] = detail::invoke(op, in[i]);
+            }
+        }
+
+        //v as an lvalue if Self is an lvalue reference, otherwise as an rvalue
+        template <class Self, class V>
+        constexpr decltype(auto) forward_element(V& v) noexcept {
+            if constexpr (std::is_lvalue_reference_v<Self>) {
+                return static_cast<V&>(v);
+            } else {
+                return static_cast<V&&>(v);
+            }
+        }
+    }
+
+    //A column of optional<T>, stored as a contiguous array of values and a packed validity
+    //bitmap with one bit per slot. Empty slots hold a value-initialised T, so T must be
+    //default constructible.
+    //
+    //transform, transform_optional and call work like on optional<T>, but over every slot
+    //at once: the bitmap is scanned a word at a time and only present values are touched.
+    template <class T>
+    class optional_vector {
+        static_assert(!std::is_same_v<T, bool>, "std::vector<bool> is not contiguous, use optional_vector<char>");
+    public:
+        using value_type = T;
+        using size_type = std::size_t;
+        static constexpr size_type bits_per_word = 64;
+
+        optional_vector() = default;
+
+        explicit optional_vector(size_type n)
+            : values_(n), bits_(word_count(n), 0), size_(n) { }
+
+        optional_vector(std::initializer_list<optional<T>> init)
+            : values_(values_of(init)), bits_(bits_of(init)), size_(init.size()) { }
+
+        size_type size() const noexcept { return size_; }
+        bool empty() const noexcept { return size_ == 0; }
+
+        //The number of slots that have a value
+        size_type count() const noexcept {
+            size_type n = 0;
+            for (auto word : bits_) {
+                n += detail::popcount(word);
+            }
+            return n;
+        }
+
+        void reserve(size_type n) {
+            values_.reserve(n);
+            bits_.reserve(word_count(n));
+        }
+
+        void push_back(const optional<T>& o) {
+            o.has_value() ? emplace_back(*o) : push_back_empty();
+        }
+
+        void push_back(optional<T>&& o) {
+            o.has_value() ? emplace_back(*std::move(o)) : push_back_empty();
+        }
+
+        template <class... Args>
+        void emplace_back(Args&&... args) {
+            values_.emplace_back(std::forward<Args>(args)...);
+            append_bit(true);
+        }
+
+        void push_back_empty() {
+            values_.emplace_back();
+            append_bit(false);
+        }
+
+        bool has_value(size_type i) const noexcept {
+            return (bits_[i / bits_per_word] >> (i % bits_per_word)) & 1u;
+        }
+
+        optional<T> operator[](size_type i) const {
+            return has_value(i) ? optional<T>(values_[i]) : optional<T>();
+        }
+
+        //The raw columns. Values in empty slots are unspecified.
+        const T* values() const noexcept { return values_.data(); }
+        const std::uint64_t* validity() const noexcept { return bits_.data(); }
+
+        template <class UnaryOperation>
+        decltype(auto) transform(UnaryOperation&& op) & {
+            return transform_impl(*this, op);
+        }
+
+        template <class UnaryOperation>
+        decltype(auto) transform(UnaryOperation&& op) const& {
+            return transform_impl(*this, op);
+        }
+
+        template <class UnaryOperation>
+        decltype(auto) transform(UnaryOperation&& op) && {
+            return transform_impl(std::move(*this), op);
+        }
+
+        template <class UnaryOperation>
+        decltype(auto) transform(UnaryOperation&& op) const&& {
+            return transform_impl(std::move(*this), op);
+        }
+
+        template <class UnaryOperation>
+        decltype(auto) transform_optional(UnaryOperation&& op) & {
+            return transform_optional_impl(*this, op);
+        }
+
+        template <class UnaryOperation>
+        decltype(auto) transform_optional(UnaryOperation&& op) const& {
+            return transform_optional_impl(*this, op);
+        }
+
+        template <class UnaryOperation>
+        decltype(auto) transform_optional(UnaryOperation&& op) && {
+            return transform_optional_impl(std::move(*this), op);
+        }
+
+        template <class UnaryOperation>
+        decltype(auto) transform_optional(UnaryOperation&& op) const&& {
+            return transform_optional_impl(std::move(*this), op);
+        }
+
+        //Like transform, but for arithmetic T and results, and without testing presence per slot:
+        //op is called on every slot, empty ones included, in a straight loop the compiler can
+        //vectorise, and the result simply takes over the validity bitmap. Use it when op is cheap
+        //and safe to call on any value (no side effects, no traps such as integer division by
+        //zero), since then it beats branching on every slot, especially when empties are common.
+        //The bool results of a predicate are stored as an optional_vector<char> of 0 and 1.
+        template <class UnaryOperation>
+        auto transform_lanes(UnaryOperation&& op) const {
+            static_assert(std::is_arithmetic_v<T>, "transform_lanes requires an arithmetic T");
+            using ValueType = detail::remove_cvref_t<detail::invoke_result_t<UnaryOperation&, const T&>>;
+            static_assert(std::is_arithmetic_v<ValueType>, "transform_lanes requires an arithmetic result");
+            using LaneType = std::conditional_t<std::is_same_v<ValueType, bool>, char, ValueType>;
+            optional_vector<LaneType> result(size_);
+            result.bits_ = bits_;
+            detail::transform_lanes(values_.data(), result.values_.data(), size_, op);
+            return result;
+        }
+
+        template <class UnaryOperation>
+        void call(UnaryOperation&& op) & {
+            call_impl(*this, op);
+        }
+
+        template <class UnaryOperation>
+        void call(UnaryOperation&& op) const& {
+            call_impl(*this, op);
+        }
+
+        template <class UnaryOperation>
+        void call(UnaryOperation&& op) && {
+            call_impl(std::move(*this), op);
+        }
+
+        template <class UnaryOperation>
+        void call(UnaryOperation&& op) const&& {
+            call_impl(std::move(*this), op);
+        }
+
+    private:
+        template <class U>
+        friend class optional_vector;
+
+        static size_type word_count(size_type n) noexcept {
+            return (n + bits_per_word - 1) / bits_per_word;
+        }
+
+        static std::vector<T> values_of(std::initializer_list<optional<T>> init) {
+            std::vector<T> values;
+            values.reserve(init.size());
+            for (const auto& o : init) {
+                if (o.has_value()) {
+                    values.push_back(*o);
+                } else {
+                    values.emplace_back();
+                }
+            }
+            return values;
+        }
+
+        static std::vector<std::uint64_t> bits_of(std::initializer_list<optional<T>> init) {
+            std::vector<std::uint64_t> bits(word_count(init.size()), 0);
+            size_type i = 0;
+            for (const auto& o : init) {
+                bits[i / bits_per_word] |= std::uint64_t(o.has_value()) << (i % bits_per_word);
+                ++i;
+            }
+            return bits;
+        }
+
+        void append_bit(bool present) {
+            if (size_ % bits_per_word == 0) {
+                bits_.push_back(0);
+            }
+            bits_.back() |= std::uint64_t(present) << (size_ % bits_per_word);
+            ++size_;
+        }
+
+        //Calls f(i) for the index of every slot that has a value, in order
+        template <class F>
+        void for_each_present(F f) const {
+            for (size_type w = 0; w < bits_.size(); ++w) {
+                for (auto word = bits_[w]; word != 0; word &= word - 1) {
+                    f(w * bits_per_word + detail::count_trailing_zeros(word));
+                }
+            }
+        }
+
+        template <class Self, class UnaryOperation>
+        static auto transform_impl(Self&& self, UnaryOperation& op) {
+            using ValueType = detail::remove_cvref_t<
+                detail::invoke_result_t<UnaryOperation&, decltype(detail::forward_element<Self>(self.values_[0]))>>;
+            optional_vector<ValueType> result(self.size_);
+            result.bits_ = self.bits_;
+            self.for_each_present([&](size_type i) {
+                result.values_[i] = detail::invoke(op, detail::forward_element<Self>(self.values_[i]));
+            });
+            return result;
+        }
+
+        template <class Self, class UnaryOperation>
+        static auto transform_optional_impl(Self&& self, UnaryOperation& op) {
+            using OptionalType = detail::invoke_result_t<UnaryOperation&, decltype(detail::forward_element<Self>(self.values_[0]))>;
+            using ValueType = std::decay_t<decltype(*std::declval<OptionalType>())>;
+            optional_vector<ValueType> result(self.size_);
+            self.for_each_present([&](size_type i) {
+                auto r = detail::invoke(op, detail::forward_element<Self>(self.values_[i]));
+                if (r.has_value()) {
+                    result.values_[i] = *std::move(r);
+                    result.bits_[i / bits_per_word] |= std::uint64_t(1) << (i % bits_per_word);
+                }
+            });
+            return result;
+        }
+
+        template <class Self, class UnaryOperation>
+        static void call_impl(Self&& self, UnaryOperation& op) {
+            self.for_each_present([&](size_type i) {
+                detail::invoke(op, detail::forward_element<Self>(self.values_[i]));
+            });
+        }
+
+        std::vector<T> values_{};
+        std::vector<std::uint64_t> bits_{};
+        size_type size_ = 0;
+    };
+}
+#endif
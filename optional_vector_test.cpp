@@ -0,0 +1,152 @@
+#include "optional_vector.h"
+#include "catch.hpp"
+
+#include <string>
+
+using std::string;
+using knatten::optional;
+using knatten::optional_vector;
+
+TEST_CASE("optional_vector") {
+    SECTION("push_back and access") {
+        optional_vector<int> v;
+        v.push_back(optional(1));
+        v.push_back(optional<int>());
+        v.emplace_back(3);
+        v.push_back_empty();
+        REQUIRE(v.size() == 4);
+        REQUIRE(v.count() == 2);
+        REQUIRE(v.has_value(0) == true);
+        REQUIRE(v.has_value(1) == false);
+        REQUIRE(v[2].value() == 3);
+        REQUIRE(v[3].has_value() == false);
+        REQUIRE(v.values()[2] == 3);
+        REQUIRE(v.validity()[0] == 0b0101);
+    }
+
+    SECTION("across several bitmap words") {
+        optional_vector<int> v;
+        for (int i = 0; i < 200; ++i) {
+            v.push_back(i % 3 == 0 ? optional(i) : optional<int>());
+        }
+        REQUIRE(v.count() == 67);
+        REQUIRE(v[198].value() == 198);
+        REQUIRE(v[199].has_value() == false);
+    }
+
+    SECTION("sized constructor is all empty") {
+        optional_vector<int> v(70);
+        REQUIRE(v.size() == 70);
+        REQUIRE(v.count() == 0);
+    }
+}
+
+TEST_CASE("optional_vector transform") {
+    SECTION("with lvalue") {
+        optional_vector<int> v{1, {}, 3};
+        auto p = v.transform([](int& i){ return i*2;});
+        REQUIRE(p.size() == 3);
+        REQUIRE(p[0].value() == 2);
+        REQUIRE(p[1].has_value() == false);
+        REQUIRE(p[2].value() == 6);
+    }
+
+    SECTION("with const lvalue") {
+        const optional_vector<int> v{1, {}, 3};
+        auto p = v.transform([](const int& i){ return string(i, 'x');});
+        REQUIRE(p[0].value() == "x");
+        REQUIRE(p[1].has_value() == false);
+        REQUIRE(p[2].value() == "xxx");
+    }
+
+    SECTION("with rvalue") {
+        auto p = optional_vector<string>{string("foo"), {}}
+            .transform([](string&& s){ return std::move(s) + "bar";});
+        REQUIRE(p[0].value() == "foobar");
+        REQUIRE(p[1].has_value() == false);
+    }
+
+    SECTION("only calls op on present values") {
+        optional_vector<int> v(130);
+        v.emplace_back(5);
+        int calls = 0;
+        auto p = v.transform([&calls](int i){ ++calls; return i;});
+        REQUIRE(calls == 1);
+        REQUIRE(p.count() == 1);
+        REQUIRE(p[130].value() == 5);
+    }
+}
+
+TEST_CASE("optional_vector transform_optional") {
+    optional_vector<int> v{1, {}, 3, 4};
+    auto p = v.transform_optional([](int i){ return i % 2 ? optional(i*10) : optional<int>();});
+    REQUIRE(p.size() == 4);
+    REQUIRE(p.count() == 2);
+    REQUIRE(p[0].value() == 10);
+    REQUIRE(p[1].has_value() == false);
+    REQUIRE(p[2].value() == 30);
+    REQUIRE(p[3].has_value() == false);
+}
+
+TEST_CASE("optional_vector call") {
+    SECTION("with lvalue") {
+        optional_vector<int> v{1, {}, 3};
+        int sum = 0;
+        v.call([&sum](int& i){ sum += i;});
+        REQUIRE(sum == 4);
+    }
+
+    SECTION("with rvalue") {
+        string all;
+        optional_vector<string>{string("a"), {}, string("b")}.call([&all](string&& s){ all += s;});
+        REQUIRE(all == "ab");
+    }
+}
+
+TEST_CASE("optional_vector transform_lanes") {
+    SECTION("keeps the validity of the source") {
+        optional_vector<double> v;
+        for (int i = 0; i < 150; ++i) {
+            v.push_back(i % 2 ? optional(double(i)) : optional<double>());
+        }
+        auto p = v.transform_lanes([](double d){ return float(d * 0.5);});
+        REQUIRE(p.size() == 150);
+        REQUIRE(p.count() == 75);
+        REQUIRE(p[0].has_value() == false);
+        REQUIRE(p[1].value() == 0.5f);
+        REQUIRE(p[149].value() == 74.5f);
+    }
+
+    SECTION("calls op on every slot") {
+        optional_vector<int> v{1, {}, {}, 4};
+        int calls = 0;
+        auto p = v.transform_lanes([&calls](int i){ ++calls; return i + 1;});
+        REQUIRE(calls == 4);
+        REQUIRE(p[0].value() == 2);
+        REQUIRE(p[1].has_value() == false);
+        REQUIRE(p[3].value() == 5);
+    }
+
+    SECTION("with a predicate") {
+        optional_vector<int> v{1, {}, 2, 3};
+        auto even = v.transform_lanes([](int i){ return i % 2 == 0;});
+        static_assert(std::is_same_v<decltype(even), optional_vector<char>>);
+        REQUIRE(even[0].value() == 0);
+        REQUIRE(even[1].has_value() == false);
+        REQUIRE(even[2].value() == 1);
+        REQUIRE(even[3].value() == 0);
+    }
+}
+
+TEST_CASE("optional_vector with member pointers") {
+    struct record {
+        string name{};
+        std::size_t size() const { return name.size(); }
+    };
+    optional_vector<record> v{record{"foo"}, {}};
+    auto sizes = v.transform(&record::size);
+    REQUIRE(sizes[0].value() == 3);
+    REQUIRE(sizes[1].has_value() == false);
+    auto names = v.transform(&record::name);
+    REQUIRE(names[0].value() == "foo");
+}
@@ -0,0 +1,33 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+//A payload type for tests that counts how it gets constructed, copied, moved and destroyed
+struct probe {
+    struct counts {
+        int constructions = 0;
+        int copies = 0;
+        int moves = 0;
+        int copy_assignments = 0;
+        int move_assignments = 0;
+        int destructions = 0;
+    };
+
+    //Counts since the last reset()
+    static counts& count() {
+        static counts c;
+        return c;
+    }
+
+    static void reset() { count() = counts(); }
+
+    probe() : value(0) { ++count().constructions; }
+    explicit probe(int v) : value(v) { ++count().constructions; }
+    probe(const probe& rhs) : value(rhs.value) { ++count().copies; }
+    probe(probe&& rhs) noexcept : value(rhs.value) { ++count().moves; }
+    probe& operator=(const probe& rhs) { value = rhs.value; ++count().copy_assignments; return *this; }
+    probe& operator=(probe&& rhs) noexcept { value = rhs.value; ++count().move_assignments; return *this; }
+    ~probe() { ++count().destructions; }
+
+    int value;
+};
+#endif